@@ -1,308 +1,809 @@
-#include "types.h"
-#include "serial.h"
-#include "string.h"
-#include "memory.h"
-#include "process.h"
-#include "scheduler.h"
-#define MAX_INPUT 128
-
-// --- Test Processes ---
-void worker_process_high(void)
-{
-    serial_puts("[P-HIGH] high priority process started\n");
-    for (int i = 0; i < 5; i++)
-    {
-        serial_puts("[P-HIGH] iteration ");
-        serial_put_num(i);
-        serial_puts("\n");
-        for (volatile int j = 0; j < 500000; j++);
-    }
-    serial_puts("[P-HIGH] completed\n");
-    process_exit();
-}
-
-void worker_process_low(void)
-{
-    serial_puts("[P-LOW] low priority process started\n");
-    for (int i = 0; i < 3; i++)
-    {
-        serial_puts("[P-LOW] iteration ");
-        serial_put_num(i);
-        serial_puts("\n");
-        for (volatile int j = 0; j < 500000; j++);
-    }
-    serial_puts("[P-LOW] completed\n");
-    process_exit();
-}
-
-void test_simple_process(void)
-{
-    serial_puts("[test-proc] process running\n");
-    process_exit();
-}
-
-void ipc_test_sender(void)
-{
-    serial_puts("[IPC-SEND] sender process started\n");
-    
-    for (int i = 0; i < 3; i++)
-    {
-        int result = process_send(2, 100 + i);
-        if (result == 0)
-            serial_puts("[IPC-SEND] message sent\n");
-        for (volatile int j = 0; j < 300000; j++);
-    }
-    
-    process_exit();
-}
-
-void ipc_test_receiver(void)
-{
-    serial_puts("[IPC-RECV] receiver process started\n");
-    
-    uint32_t msg_val;
-    for (int i = 0; i < 3; i++)
-    {
-        if (process_receive(&msg_val) == 0)
-        {
-            serial_puts("[IPC-RECV] got message value\n");
-        }
-        for (volatile int j = 0; j < 300000; j++);
-    }
-    
-    process_exit();
-}
-
-// --- Memory Tests ---
-void test_memory_manager(void)
-{
-    serial_puts("\n========== MEMORY TEST ==========\n");
-    
-    serial_puts("[TEST] Heap allocation...\n");
-    void *p1 = kmalloc(50);
-    void *p2 = kmalloc(100);
-    void *p3 = kmalloc(200);
-    
-    if (p1 && p2 && p3)
-        serial_puts("[OK] Multiple heap allocations\n");
-    else
-        serial_puts("[FAIL] Heap allocation\n");
-    
-    serial_puts("[TEST] Stack allocation...\n");
-    void *s1 = alloc_stack();
-    void *s2 = alloc_stack();
-    
-    if (s1 && s2)
-        serial_puts("[OK] Stack allocations\n");
-    else
-        serial_puts("[FAIL] Stack allocation\n");
-    
-    serial_puts("[TEST] Memory deallocation...\n");
-    kfree(p1);
-    kfree(p2);
-    free_stack(s1);
-    serial_puts("[OK] Deallocations completed\n");
-    
-    memory_print_stats();
-}
-
-// --- Process Tests ---
-void test_process_manager(void)
-{
-    serial_puts("\n========== PROCESS TEST ==========\n");
-    
-    serial_puts("[TEST] Create test process...\n");
-    int p1 = process_create(test_simple_process, 5);
-    if (p1 >= 0)
-        serial_puts("[OK] Process creation\n");
-    
-    serial_puts("[TEST] State transitions...\n");
-    process_set_state(p1, PROC_BLOCKED);
-    if (process_get_state(p1) == PROC_BLOCKED)
-        serial_puts("[OK] State change to BLOCKED\n");
-    
-    process_set_state(p1, PROC_READY);
-    if (process_get_state(p1) == PROC_READY)
-        serial_puts("[OK] State change to READY\n");
-    
-    serial_puts("[TEST] Get process utilities...\n");
-    pcb_t *proc = process_get(p1);
-    if (proc && proc->pid == (uint32_t)p1)
-        serial_puts("[OK] process_get() works\n");
-    
-    uint32_t active = process_count_active();
-    serial_puts("[OK] Active processes: ");
-    serial_put_num(active);
-    serial_puts("\n");
-    
-    process_list();
-}
-
-// --- Scheduler Tests ---
-void test_scheduler(void)
-{
-    serial_puts("\n========== SCHEDULER TEST ==========\n");
-    
-    serial_puts("[TEST] Initialize scheduler...\n");
-    scheduler_init();
-    serial_puts("[OK] Scheduler initialized\n");
-    
-    serial_puts("[TEST] Set time quantum to 20ms...\n");
-    scheduler_set_quantum(20);
-    
-    if (scheduler_get_quantum() == 20)
-        serial_puts("[OK] Quantum set correctly\n");
-    
-    serial_puts("[TEST] Select next process...\n");
-    pcb_t *next = scheduler_next();
-    if (next)
-    {
-        serial_puts("[OK] Selected process PID ");
-        serial_put_num(next->pid);
-        serial_puts("\n");
-    }
-    else
-    {
-        serial_puts("[INFO] No READY process available\n");
-    }
-    
-    serial_puts("[TEST] Scheduler statistics...\n");
-    serial_puts("[OK] Scheduler test completed\n");
-    
-    serial_puts("[TEST] Apply aging algorithm...\n");
-    scheduler_apply_aging();
-    
-    scheduler_print_stats();
-}
-
-// --- IPC Tests ---
-void test_ipc(void)
-{
-    serial_puts("\n========== IPC TEST ==========\n");
-    
-    serial_puts("[TEST] Create IPC processes...\n");
-    int sender_pid = process_create(ipc_test_sender, 5);
-    int recv_pid = process_create(ipc_test_receiver, 5);
-    
-    if (sender_pid > 0 && recv_pid > 0)
-        serial_puts("[OK] IPC processes created\n");
-    
-    serial_puts("[TEST] IPC simulation...\n");
-    current_proc = process_get(sender_pid);
-    
-    uint32_t test_msg = 42;
-    if (process_send(recv_pid, test_msg) == 0)
-        serial_puts("[OK] Message sent\n");
-    
-    current_proc = process_get(recv_pid);
-    uint32_t received;
-    if (process_receive(&received) == 0)
-        serial_puts("[OK] Message received\n");
-}
-
-// --- Main Kernel Entry ---
-void kmain(void)
-{
-    char input[MAX_INPUT];
-    int pos = 0;
-
-    serial_init();
-    serial_puts("\n[BOOT] Initializing kacchiOS...\n");
-
-    memory_init();
-    process_init();
-    scheduler_init();
-
-    test_memory_manager();
-    test_process_manager();
-    test_scheduler();
-    test_ipc();
-
-    serial_puts("\n");
-    serial_puts("========================================\n");
-    serial_puts("    kacchiOS - Full Featured OS\n");
-    serial_puts("    Memory | Process | Scheduler\n");
-    serial_puts("========================================\n");
-    serial_puts("System initialized successfully!\n");
-    serial_puts("Type 'help' for commands\n\n");
-
-    while (1)
-    {
-        serial_puts("kacchiOS> ");
-        pos = 0;
-
-        while (1)
-        {
-            char c = serial_getc();
-
-            if (c == '\r' || c == '\n')
-            {
-                input[pos] = '\0';
-                serial_puts("\n");
-                break;
-            }
-            else if ((c == '\b' || c == 0x7F) && pos > 0)
-            {
-                pos--;
-                serial_puts("\b \b");
-            }
-            else if (c >= 32 && c < 127 && pos < MAX_INPUT - 1)
-            {
-                input[pos++] = c;
-                serial_putc(c);
-            }
-        }
-
-        // --- Command Processing ---
-        if (pos > 0)
-        {
-            if (input[0] == 'h' && input[1] == 'e' && input[2] == 'l' && input[3] == 'p')
-            {
-                serial_puts("\nAvailable commands:\n");
-                serial_puts("  help      - Show this help\n");
-                serial_puts("  memstat   - Show memory statistics\n");
-                serial_puts("  proclist  - List all processes\n");
-                serial_puts("  schedstat - Show scheduler stats\n");
-                serial_puts("  test      - Run all tests\n");
-                serial_puts("  exit      - Halt system\n\n");
-            }
-            else if (input[0] == 'm' && input[1] == 'e' && input[2] == 'm')
-            {
-                memory_print_stats();
-            }
-            else if (input[0] == 'p' && input[1] == 'r' && input[2] == 'o')
-            {
-                process_list();
-            }
-            else if (input[0] == 's' && input[1] == 'c' && input[2] == 'h')
-            {
-                scheduler_print_stats();
-            }
-            else if (input[0] == 't' && input[1] == 'e' && input[2] == 's')
-            {
-                serial_puts("\nRunning comprehensive tests...\n");
-                test_memory_manager();
-                test_process_manager();
-                test_scheduler();
-            }
-            else if (input[0] == 'e' && input[1] == 'x' && input[2] == 'i')
-            {
-                serial_puts("System halting...\n");
-                for (;;)
-                {
-                    __asm__ volatile("hlt");
-                }
-            }
-            else
-            {
-                serial_puts("Unknown command. Type 'help' for commands.\n");
-            }
-        }
-    }
-
-    /* Should never reach here */
-    for (;;)
-    {
-        __asm__ volatile("hlt");
-    }
+#include "types.h"
+#include "serial.h"
+#include "string.h"
+#include "multiboot.h"
+#include "gdt.h"
+#include "idt.h"
+#include "pic.h"
+#include "pit.h"
+#include "cpu.h"
+#include "pmm.h"
+#include "memory.h"
+#include "paging.h"
+#include "slab.h"
+#include "process.h"
+#include "scheduler.h"
+#include "timer.h"
+#include "smp.h"
+#include "log.h"
+#include "trace.h"
+#define MAX_INPUT 128
+#define SHELL_PRIORITY    1
+#define SHELL_STACK_SIZE  (16 * 1024)
+#define IPC_BENCH_MAX_ROUNDS  1000000
+
+// --- Test Processes ---
+void worker_process_high(void)
+{
+    serial_puts("[P-HIGH] high priority process started\n");
+    for (int i = 0; i < 5; i++)
+    {
+        serial_puts("[P-HIGH] iteration ");
+        serial_put_num(i);
+        serial_puts("\n");
+        process_sleep(MS_TO_TICKS(50));
+    }
+    serial_puts("[P-HIGH] completed\n");
+    process_exit();
+}
+
+void worker_process_low(void)
+{
+    serial_puts("[P-LOW] low priority process started\n");
+    for (int i = 0; i < 3; i++)
+    {
+        serial_puts("[P-LOW] iteration ");
+        serial_put_num(i);
+        serial_puts("\n");
+        process_sleep(MS_TO_TICKS(50));
+    }
+    serial_puts("[P-LOW] completed\n");
+    process_exit();
+}
+
+void test_simple_process(void)
+{
+    serial_puts("[test-proc] process running\n");
+    process_exit();
+}
+
+static int ipc_test_recv_pid;
+
+void ipc_test_sender(void)
+{
+    serial_puts("[IPC-SEND] sender process started\n");
+    
+    for (int i = 0; i < 3; i++)
+    {
+        int result = process_send_timeout(ipc_test_recv_pid, 100 + i, MS_TO_TICKS(100));
+        if (result == 0)
+            serial_puts("[IPC-SEND] message sent\n");
+        process_sleep(MS_TO_TICKS(30));
+    }
+    
+    process_exit();
+}
+
+/* Blocks in process_receive() between messages instead of polling */
+void ipc_test_receiver(void)
+{
+    serial_puts("[IPC-RECV] receiver process started\n");
+    
+    uint32_t msg_val;
+    for (int i = 0; i < 3; i++)
+    {
+        if (process_receive(&msg_val) == 0)
+        {
+            serial_puts("[IPC-RECV] got message value ");
+            serial_put_num(msg_val);
+            serial_puts("\n");
+        }
+    }
+    
+    process_exit();
+}
+
+static int rpc_test_server_pid;
+
+/* Doubles whatever it is asked; never exits */
+void rpc_test_server(void)
+{
+    uint32_t request;
+
+    serial_puts("[RPC-SERVER] server process started\n");
+    ipc_reply_wait(0, &request);
+    for (;;)
+        ipc_reply_wait(request * 2, &request);
+}
+
+void rpc_test_client(void)
+{
+    serial_puts("[RPC-CLIENT] client process started\n");
+
+    for (uint32_t i = 1; i <= 3; i++)
+    {
+        uint32_t reply;
+        if (ipc_call(rpc_test_server_pid, i * 10, &reply) == 0)
+        {
+            serial_puts("[RPC-CLIENT] reply ");
+            serial_put_num(reply);
+            serial_puts("\n");
+        }
+    }
+
+    process_exit();
+}
+
+/* Kills a caller while its request sits in the mailbox of a server that
+   never runs: the request keeps the caller's PCB from being reclaimed
+   until the server is killed too and fails it */
+static int kill_test_server_pid;
+
+static void kill_test_caller(void)
+{
+    uint32_t reply;
+
+    ipc_call(kill_test_server_pid, 1, &reply);
+    serial_puts("[FAIL] Killed caller returned from ipc_call\n");
+    process_exit();
+}
+
+static void ipc_kill_test(void)
+{
+    int server = process_create_blocked(test_simple_process, 5, 0, 0);
+    kill_test_server_pid = server;
+    int caller = process_create(kill_test_caller, 5, 0, 0);
+
+    for (int i = 0; i < 100 && process_get_state(caller) != PROC_BLOCKED; i++)
+        process_sleep(1);
+
+    int killed = process_set_state(caller, PROC_TERMINATED) == 0;
+
+    /* Idle CPUs reap meanwhile */
+    process_sleep(MS_TO_TICKS(20));
+    int pinned = process_get_state(caller) == PROC_TERMINATED;
+
+    process_set_state(server, PROC_TERMINATED);
+    for (int i = 0; i < 100 && (process_get_state(caller) != PROC_UNUSED ||
+                                process_get_state(server) != PROC_UNUSED); i++)
+        process_sleep(1);
+    int reaped = process_get_state(caller) == PROC_UNUSED &&
+                 process_get_state(server) == PROC_UNUSED;
+
+    if (server > 0 && caller > 0 && killed && pinned && reaped)
+        serial_puts("[OK] Killed caller kept until its request was failed\n");
+    else
+        serial_puts("[FAIL] Killed caller with a queued request\n");
+    process_exit();
+}
+
+/* Tries to make a caller waiting for its reply READY, which is refused,
+   then lets the server answer: the caller gets the reply and both pins
+   and PCBs are given back exactly once */
+static int unblock_test_server_pid;
+static uint32_t unblock_test_reply;
+
+static void unblock_test_server(void)
+{
+    uint32_t request;
+
+    ipc_reply_wait(0, &request);
+    ipc_reply_wait(request + 1, &request);
+}
+
+static void unblock_test_caller(void)
+{
+    uint32_t reply;
+
+    if (ipc_call(unblock_test_server_pid, 7, &reply) == 0)
+        unblock_test_reply = reply;
+    process_exit();
+}
+
+static void ipc_unblock_test(void)
+{
+    int server = process_create_blocked(unblock_test_server, 5, 0, 0);
+    unblock_test_server_pid = server;
+    int caller = process_create(unblock_test_caller, 5, 0, 0);
+
+    for (int i = 0; i < 100 && process_get_state(caller) != PROC_BLOCKED; i++)
+        process_sleep(1);
+
+    int refused = process_set_state(caller, PROC_READY) < 0 &&
+                  process_get_state(caller) == PROC_BLOCKED;
+
+    process_set_state(server, PROC_READY);
+    for (int i = 0; i < 100 && process_get_state(caller) != PROC_UNUSED; i++)
+        process_sleep(1);
+    int answered = unblock_test_reply == 8 &&
+                   process_get_state(caller) == PROC_UNUSED;
+
+    process_set_state(server, PROC_TERMINATED);
+
+    if (server > 0 && caller > 0 && refused && answered)
+        serial_puts("[OK] Reply-waiting caller kept blocked until answered\n");
+    else
+        serial_puts("[FAIL] Unblocking a reply-waiting caller\n");
+    process_exit();
+}
+
+// --- IPC Benchmark ---
+/* Ping-pong between two processes that block in process_receive(), so
+   every message is a direct handoff into the other side, then the same
+   with ipc_call() against the other one serving in ipc_reply_wait() */
+static int bench_ping_pid;
+static int bench_pong_pid;
+static uint32_t bench_rounds;
+
+static void ipc_bench_pong(void)
+{
+    uint32_t value;
+
+    for (uint32_t i = 0; i <= bench_rounds; i++)
+    {
+        process_receive(&value);
+        process_send(bench_ping_pid, value);
+    }
+
+    process_receive(&value);
+    for (uint32_t i = 0; i <= bench_rounds; i++)
+        ipc_reply_wait(value, &value);
+    process_exit();
+}
+
+static void ipc_bench_ping(void)
+{
+    uint32_t value;
+    uint32_t handoffs = scheduler_get_handoffs();
+
+    bench_ping_pid = process_current_pid();
+
+    /* Warm up once so both sides start out blocked in receive */
+    process_send(bench_pong_pid, 0);
+    process_receive(&value);
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 1; i <= bench_rounds; i++)
+    {
+        process_send(bench_pong_pid, i);
+        process_receive(&value);
+    }
+    uint64_t end = rdtsc();
+    uint32_t send_cost = div64_32(end - start, bench_rounds);
+
+    ipc_call(bench_pong_pid, 0, &value);
+
+    start = rdtsc();
+    for (uint32_t i = 1; i <= bench_rounds; i++)
+        ipc_call(bench_pong_pid, i, &value);
+    end = rdtsc();
+    uint32_t call_cost = div64_32(end - start, bench_rounds);
+
+    /* Lets pong's last ipc_reply_wait() return so it can exit */
+    process_send(bench_pong_pid, 0);
+
+    serial_puts("\n========== IPC BENCHMARK ==========\n");
+    serial_puts("Round trips: ");
+    serial_put_num(bench_rounds);
+    serial_puts("\n");
+    serial_puts("send + receive:     ");
+    serial_put_num(send_cost);
+    serial_puts(" cycles/round trip\n");
+    serial_puts("call + reply_wait:  ");
+    serial_put_num(call_cost);
+    serial_puts(" cycles/round trip\n");
+    serial_puts("Direct handoffs: ");
+    serial_put_num(scheduler_get_handoffs() - handoffs);
+    serial_puts("\n");
+    serial_puts("===================================\n\n");
+    process_exit();
+}
+
+// --- Memory Tests ---
+void test_memory_manager(void)
+{
+    serial_puts("\n========== MEMORY TEST ==========\n");
+    
+    serial_puts("[TEST] Heap allocation...\n");
+    void *p1 = kmalloc(50);
+    void *p2 = kmalloc(100);
+    void *p3 = kmalloc(200);
+    
+    if (p1 && p2 && p3)
+        serial_puts("[OK] Multiple heap allocations\n");
+    else
+        serial_puts("[FAIL] Heap allocation\n");
+    
+    serial_puts("[TEST] Stack allocation...\n");
+    void *s1 = alloc_stack(0);
+    void *s2 = alloc_stack(16 * 1024);
+    
+    if (s1 && s2)
+        serial_puts("[OK] Stack allocations\n");
+    else
+        serial_puts("[FAIL] Stack allocation\n");
+    
+    serial_puts("[TEST] Memory deallocation...\n");
+    kfree(p1);
+    kfree(p2);
+    free_stack(s1);
+    serial_puts("[OK] Deallocations completed\n");
+
+    serial_puts("[TEST] Freed memory reuse...\n");
+    void *p4 = kmalloc(50);
+    if (p4 == p1)
+        serial_puts("[OK] Size class reused freed block\n");
+    else
+        serial_puts("[FAIL] Freed block not reused\n");
+
+    void *big = kmalloc(6000);
+    kfree(big);
+    void *big2 = kmalloc(6000);
+    if (big && big == big2)
+        serial_puts("[OK] Large allocation reused freed pages\n");
+    else
+        serial_puts("[FAIL] Large allocation reuse\n");
+    kfree(big2);
+    kfree(p4);
+    kfree(p3);
+    free_stack(s2);
+
+    serial_puts("[TEST] Stack buddy coalescing...\n");
+    void *b1 = alloc_stack(4096);
+    void *b2 = alloc_stack(4096);
+    void *b3 = alloc_stack(8192);
+    free_stack(b1);
+    free_stack(b2);
+    void *b4 = alloc_stack(8192);
+    if (b4 && b4 == b1 && (uint32_t)b2 == ((uint32_t)b1 ^ 4096))
+        serial_puts("[OK] Freed buddies merged and reused\n");
+    else
+        serial_puts("[FAIL] Buddy coalescing\n");
+    free_stack(b4);
+    free_stack(b3);
+
+    serial_puts("[TEST] Slab cache...\n");
+    static kmem_cache_t *cache;
+    if (!cache)
+        cache = kmem_cache_create("test", 40, 0, 0);
+    void *o1 = kmem_cache_alloc(cache);
+    void *o2 = kmem_cache_alloc(cache);
+    kmem_cache_free(cache, o1);
+    void *o3 = kmem_cache_alloc(cache);
+    if (o1 && o2 && o3 == o1 && ((uint32_t)o1 & ~0xFFFu) == ((uint32_t)o2 & ~0xFFFu))
+        serial_puts("[OK] Slab objects packed and recycled\n");
+    else
+        serial_puts("[FAIL] Slab cache\n");
+    kmem_cache_free(cache, o2);
+    kmem_cache_free(cache, o3);
+
+    memory_print_stats();
+}
+
+// --- Process Tests ---
+void test_process_manager(void)
+{
+    serial_puts("\n========== PROCESS TEST ==========\n");
+    
+    serial_puts("[TEST] Warm stack cache...\n");
+    if (process_stack_cache_warm(2) >= 2)
+        serial_puts("[OK] Stack cache warmed\n");
+
+    serial_puts("[TEST] Create test process...\n");
+    /* BLOCKED until the transitions below are done, or an idle CPU
+       would run it straight away */
+    int p1 = process_create_blocked(test_simple_process, 5, 0, 0);
+    if (p1 >= 0)
+        serial_puts("[OK] Process creation\n");
+    
+    serial_puts("[TEST] State transitions...\n");
+    if (process_get_state(p1) == PROC_BLOCKED)
+        serial_puts("[OK] Created BLOCKED\n");
+
+    serial_puts("[TEST] Get process utilities...\n");
+    pcb_t *proc = process_get(p1);
+    if (proc && proc->pid == (uint32_t)p1)
+        serial_puts("[OK] process_get() works\n");
+
+    serial_puts("[TEST] Address space and stack guard...\n");
+    if (proc && proc->page_dir && proc->page_dir != paging_kernel_dir() &&
+        !paging_is_mapped(proc->page_dir, (uint32_t)proc->stack_base - PAGE_SIZE) &&
+        paging_is_mapped(proc->page_dir, (uint32_t)proc->stack_base))
+        serial_puts("[OK] Own page directory, guard page unmapped\n");
+    else
+        serial_puts("[FAIL] Address space setup\n");
+    
+    uint32_t active = process_count_active();
+    serial_puts("[OK] Active processes: ");
+    serial_put_num(active);
+    serial_puts("\n");
+    
+    process_list();
+
+    /* From here on it may be running on any CPU */
+    if (process_set_state(p1, PROC_READY) == 0)
+        serial_puts("[OK] State change to READY\n");
+}
+
+// --- Scheduler Tests ---
+/* Boot only: it re-initializes this CPU's scheduler and changes the
+   quantum, which a live system must not have done under it */
+void test_scheduler(void)
+{
+    serial_puts("\n========== SCHEDULER TEST ==========\n");
+    
+    serial_puts("[TEST] Initialize scheduler...\n");
+    scheduler_init();
+    serial_puts("[OK] Scheduler initialized\n");
+    
+    serial_puts("[TEST] Set time quantum to 20ms...\n");
+    scheduler_set_quantum(20);
+    
+    if (scheduler_get_quantum() == 20)
+        serial_puts("[OK] Quantum set correctly\n");
+    
+    serial_puts("[TEST] Select next process...\n");
+    pcb_t *next = scheduler_next();
+    if (next)
+    {
+        serial_puts("[OK] Selected process PID ");
+        serial_put_num(next->pid);
+        serial_puts("\n");
+    }
+    else
+    {
+        serial_puts("[INFO] No READY process available\n");
+    }
+    
+    serial_puts("[TEST] Scheduler statistics...\n");
+    serial_puts("[OK] Scheduler test completed\n");
+    
+    serial_puts("[TEST] Apply aging algorithm...\n");
+    scheduler_apply_aging();
+    
+    scheduler_print_stats();
+}
+
+// --- IPC Tests ---
+void test_ipc(void)
+{
+    serial_puts("\n========== IPC TEST ==========\n");
+    
+    serial_puts("[TEST] Create IPC processes...\n");
+    int sender_pid = process_create(ipc_test_sender, 5, 0, 0);
+    int recv_pid = process_create(ipc_test_receiver, 5, 0, 0);
+    ipc_test_recv_pid = recv_pid;
+    rpc_test_server_pid = process_create(rpc_test_server, 5, 0, 0);
+    int client_pid = process_create(rpc_test_client, 5, 0, 0);
+    process_create(ipc_kill_test, 5, 0, 0);
+    process_create(ipc_unblock_test, 5, 0, 0);
+    
+    if (sender_pid > 0 && recv_pid > 0 && rpc_test_server_pid > 0 && client_pid > 0)
+        serial_puts("[OK] IPC processes created\n");
+    
+    serial_puts("[TEST] IPC simulation...\n");
+    this_cpu()->current = process_get(sender_pid);
+    
+    uint32_t test_msg = 42;
+    if (process_send(recv_pid, test_msg) == 0)
+        serial_puts("[OK] Message sent\n");
+    
+    this_cpu()->current = process_get(recv_pid);
+    uint32_t received;
+    if (process_receive(&received) == 0)
+        serial_puts("[OK] Message received\n");
+
+    serial_puts("[TEST] Mailbox capacity and order...\n");
+    int small_pid = process_create(test_simple_process, 5, 0, 3);
+    pcb_t *small = process_get(small_pid);
+
+    this_cpu()->current = process_get(sender_pid);
+    uint32_t sent = 0;
+    while (small && sent <= MAILBOX_MAX && process_send(small_pid, 200 + sent) == 0)
+        sent++;
+
+    this_cpu()->current = small;
+    uint32_t in_order = small != 0;
+    for (uint32_t i = 0; small && i < sent; i++)
+    {
+        if (process_receive(&received) < 0 || received != 200 + i)
+            in_order = 0;
+    }
+
+    if (small && sent == mailbox_capacity(&small->mailbox) && sent == 4 && in_order)
+        serial_puts("[OK] Mailbox rounded up to 4, filled and drained in order\n");
+    else
+        serial_puts("[FAIL] Mailbox capacity or order\n");
+
+    serial_puts("[TEST] Batch send and receive...\n");
+    uint32_t batch[6] = { 300, 301, 302, 303, 304, 305 };
+    message_t got[8];
+
+    this_cpu()->current = process_get(sender_pid);
+    int batch_sent = small ? process_send_batch(small_pid, batch, 6) : -1;
+
+    this_cpu()->current = small;
+    int batch_got = small ? process_receive_batch(got, 8) : -1;
+
+    in_order = batch_got == batch_sent;
+    for (int i = 0; in_order && i < batch_got; i++)
+    {
+        if (got[i].value != batch[i] || got[i].sender_pid != (uint32_t)sender_pid)
+            in_order = 0;
+    }
+
+    if (batch_sent == 4 && in_order)
+        serial_puts("[OK] Batch stopped at capacity and arrived in order\n");
+    else
+        serial_puts("[FAIL] Batch IPC\n");
+
+    serial_puts("[TEST] Page grant...\n");
+    pcb_t *sender = process_get(sender_pid);
+    uint32_t saved_cr3 = read_cr3();
+    uint32_t frame = 0;
+    int moved = 0;
+    int intact = 0;
+
+    /* Each side reaches the pages through its own private window, so
+       run on its page directory */
+    this_cpu()->current = sender;
+    write_cr3(sender->page_dir);
+    uint8_t *out = grant_alloc(6000);
+    if (out)
+    {
+        for (uint32_t i = 0; i < 6000; i++)
+            out[i] = (uint8_t)i;
+        moved = small && process_send_grant(small_pid, out, GRANT_MOVE, 0) == 0 &&
+                grant_size(out) == 0 && !paging_is_mapped(sender->page_dir, (uint32_t)out);
+    }
+
+    this_cpu()->current = small;
+    if (moved)
+    {
+        write_cr3(small->page_dir);
+        if (process_receive(&received) == 0 && grant_size((void*)received) == 6000)
+        {
+            uint8_t *in = (uint8_t*)received;
+
+            intact = 1;
+            for (uint32_t i = 0; i < 6000; i++)
+            {
+                if (in[i] != (uint8_t)i)
+                    intact = 0;
+            }
+            frame = *paging_get_pte(small->page_dir, received) & PTE_FRAME;
+            grant_free(in);
+        }
+    }
+    write_cr3(saved_cr3);
+
+    if (moved && intact && pmm_page((void*)frame)->type == PAGE_TYPE_FREE)
+        serial_puts("[OK] Grant moved without a copy and freed by the receiver\n");
+    else
+        serial_puts("[FAIL] Page grant\n");
+
+    /* Hand the processes back to the scheduler */
+    this_cpu()->current = 0;
+}
+
+// --- Shell Helpers ---
+/* The text after the first space, empty if there is none */
+static const char* arg_str(const char *input)
+{
+    while (*input && *input != ' ')
+        input++;
+    while (*input == ' ')
+        input++;
+    return input;
+}
+
+/* Parse the decimal argument after the first space, -1 if there is none */
+static int parse_arg(const char *input)
+{
+    input = arg_str(input);
+
+    if (*input < '0' || *input > '9')
+        return -1;
+
+    int value = 0;
+    while (*input >= '0' && *input <= '9')
+        value = value * 10 + (*input++ - '0');
+    return value;
+}
+
+static int starts_with(const char *input, const char *word)
+{
+    while (*word)
+    {
+        if (*input++ != *word++)
+            return 0;
+    }
+    return 1;
+}
+
+// --- Shell ---
+/* Echo and line editing happen in the serial driver's interrupt
+   handler; the shell stays blocked until a whole line is in */
+static void shell_process(void)
+{
+    char input[MAX_INPUT];
+    uint32_t pos;
+
+    while (1)
+    {
+        serial_puts("kacchiOS> ");
+        pos = serial_read_line(input, MAX_INPUT);
+
+        // --- Command Processing ---
+        if (pos > 0)
+        {
+            if (input[0] == 'h' && input[1] == 'e' && input[2] == 'l' && input[3] == 'p')
+            {
+                serial_puts("\nAvailable commands:\n");
+                serial_puts("  help      - Show this help\n");
+                serial_puts("  memstat   - Show memory statistics\n");
+                serial_puts("  proclist  - List all processes\n");
+                serial_puts("  schedstat - Show scheduler stats\n");
+                serial_puts("  schedpolicy [NAME] - Show or switch policy (priority, mlfq, cfs)\n");
+                serial_puts("  cpustat   - Per-CPU switches, steals and idle time\n");
+                serial_puts("  serial    - Serial output queue and drop counts\n");
+                serial_puts("  loglevel [LEVEL | SUBSYS on|off] - Show or set log filtering\n");
+                serial_puts("  trace [dump|clear|on|off] - Decode or control the event trace\n");
+                serial_puts("  stackcache [N] - Show stack cache, pre-warm to N stacks\n");
+                serial_puts("  bench [N] - Context switch cost, 4KB vs 4MB kernel pages\n");
+                serial_puts("  ipcbench [N] - IPC round trip cost between two processes\n");
+                serial_puts("  test      - Run all tests\n");
+                serial_puts("  exit      - Halt system\n\n");
+            }
+            else if (input[0] == 'm' && input[1] == 'e' && input[2] == 'm')
+            {
+                memory_print_stats();
+                paging_print_stats();
+                grant_print_stats();
+                kmem_cache_print_stats();
+            }
+            else if (input[0] == 'p' && input[1] == 'r' && input[2] == 'o')
+            {
+                process_list();
+            }
+            else if (starts_with(input, "schedp"))
+            {
+                const char *name = arg_str(input);
+                if (*name)
+                    scheduler_set_policy(name);
+                serial_puts("[scheduler] policy: ");
+                serial_puts(scheduler_policy_name());
+                serial_puts("\n");
+            }
+            else if (input[0] == 's' && input[1] == 'c' && input[2] == 'h')
+            {
+                scheduler_print_stats();
+            }
+            else if (input[0] == 'c' && input[1] == 'p' && input[2] == 'u')
+            {
+                smp_print_stats();
+            }
+            else if (starts_with(input, "logl"))
+            {
+                const char *args = arg_str(input);
+                if (*args && log_configure(args) < 0)
+                    serial_puts("Usage: loglevel [trace|debug|info|warn|error] | [mem|slab|proc|ipc|sched|all] on|off\n");
+                log_print_settings();
+            }
+            else if (starts_with(input, "trac"))
+            {
+                const char *arg = arg_str(input);
+                if (starts_with(arg, "dump"))
+                    trace_dump();
+                else if (starts_with(arg, "clear"))
+                    trace_clear();
+                else if (starts_with(arg, "on"))
+                    trace_enabled = 1;
+                else if (starts_with(arg, "off"))
+                    trace_enabled = 0;
+                else if (*arg)
+                    serial_puts("Usage: trace [dump|clear|on|off]\n");
+                trace_print_status();
+            }
+            else if (input[0] == 's' && input[1] == 'e' && input[2] == 'r')
+            {
+                serial_print_stats();
+            }
+            else if (input[0] == 's' && input[1] == 't' && input[2] == 'a')
+            {
+                int n = parse_arg(input);
+                if (n >= 0)
+                {
+                    serial_puts("[process] stack cache warmed to ");
+                    serial_put_num(process_stack_cache_warm(n));
+                    serial_puts(" stacks\n");
+                }
+                process_stack_cache_stats();
+            }
+            else if (input[0] == 'b' && input[1] == 'e' && input[2] == 'n')
+            {
+                int n = parse_arg(input);
+                paging_benchmark(n > 0 ? n : 0);
+            }
+            else if (starts_with(input, "ipcb"))
+            {
+                int n = parse_arg(input);
+                bench_rounds = n > 0 ? n : 1000;
+                if (bench_rounds > IPC_BENCH_MAX_ROUNDS)
+                    bench_rounds = IPC_BENCH_MAX_ROUNDS;
+                bench_pong_pid = process_create(ipc_bench_pong, SHELL_PRIORITY, 0, 0);
+                if (bench_pong_pid < 0 || process_create(ipc_bench_ping, SHELL_PRIORITY, 0, 0) < 0)
+                    serial_puts("[ipcbench] cannot create processes\n");
+            }
+            else if (input[0] == 't' && input[1] == 'e' && input[2] == 's')
+            {
+                serial_puts("\nRunning comprehensive tests...\n");
+                test_memory_manager();
+                test_process_manager();
+
+                /* test_scheduler() would reset the live run queues */
+                scheduler_print_stats();
+            }
+            else if (input[0] == 'e' && input[1] == 'x' && input[2] == 'i')
+            {
+                serial_puts("System halting...\n");
+                serial_flush();
+                smp_halt_others();
+                for (;;)
+                {
+                    __asm__ volatile("cli; hlt");
+                }
+            }
+            else
+            {
+                serial_puts("Unknown command. Type 'help' for commands.\n");
+            }
+        }
+    }
+}
+
+// --- Main Kernel Entry ---
+void kmain(uint32_t magic, multiboot_info_t *mbi)
+{
+    serial_init();
+    serial_puts("\n[BOOT] Initializing kacchiOS...\n");
+
+    gdt_init();
+    smp_early_init();
+    trace_init();
+    idt_init();
+    pmm_init(magic, mbi);
+    memory_init();
+    paging_init();
+    process_init();
+    scheduler_init();
+    timer_init();
+    pic_init();
+    pit_init(TIMER_HZ);
+
+    test_memory_manager();
+    test_process_manager();
+    test_scheduler();
+    test_ipc();
+
+    /* The tests above drive processes by hand on this CPU, so the other
+       CPUs only come up once they are done */
+    smp_init();
+
+    /* Start preemption; READY processes now run off the timer */
+    irq_enable();
+
+    /* Boot output above was written synchronously; from here on the
+       UART drains its ring from the THRE interrupt */
+    serial_enable_irq();
+
+    serial_puts("\n");
+    serial_puts("========================================\n");
+    serial_puts("    kacchiOS - Full Featured OS\n");
+    serial_puts("    Memory | Process | Scheduler\n");
+    serial_puts("========================================\n");
+    serial_puts("System initialized successfully!\n");
+    serial_puts("Type 'help' for commands\n\n");
+
+    if (process_create(shell_process, SHELL_PRIORITY, SHELL_STACK_SIZE, 0) < 0)
+        panic("cannot start shell");
+
+    /* From here on kmain's context is the idle task */
+    scheduler_idle();
+
+    /* Should never reach here */
+    for (;;)
+    {
+        __asm__ volatile("hlt");
+    }
 }
\ No newline at end of file
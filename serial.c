@@ -1,79 +1,327 @@
-/* serial.c - Serial port driver (COM1) */
-#include "serial.h"
-#include "io.h"
-
-#define COM1 0x3F8   /* I/O port base address for COM1 */
-
-/*
-You can find more information here: https://caro.su/msx/ocm_de1/16550.pdf
-
-Your Keyboard
-    ↓
-Terminal (stdin)
-    ↓
-QEMU (-serial stdio)
-    ↓
-Emulated COM1 port (0x3F8)
-    ↓
-serial_getc() reads from COM1
-    ↓
-Your OS receives the character
-
-If you want real keyboard input, you'd need to add a keyboard driver.
-*/
-
-void serial_init(void) {
-    outb(COM1 + 1, 0x00);    /* Disable interrupts */
-    outb(COM1 + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
-    outb(COM1 + 0, 0x03);    /* Divisor low byte (38400 baud) */
-    outb(COM1 + 1, 0x00);    /* Divisor high byte */
-    outb(COM1 + 3, 0x03);    /* 8 bits, no parity, 1 stop bit */
-    outb(COM1 + 2, 0xC7);    /* Enable FIFO, clear, 14-byte threshold */
-    outb(COM1 + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
-}
-
-static int is_transmit_empty(void) {
-    return inb(COM1 + 5) & 0x20;
-}
-
-void serial_putc(char c) {
-    if (c == '\n') {
-        serial_putc('\r');  /* Add carriage return */
-    }
-    while (!is_transmit_empty());
-    outb(COM1, c);
-}
-
-void serial_puts(const char* str) {
-    while (*str) {
-        serial_putc(*str++);
-    }
-}
-
-/* Print unsigned 32-bit number */
-void serial_put_num(uint32_t num) {
-    char buffer[12];
-    int idx = 11;
-    buffer[11] = '\0';
-
-    if (num == 0) {
-        serial_putc('0');
-        return;
-    }
-
-    while (num > 0 && idx > 0) {
-        buffer[--idx] = '0' + (num % 10);
-        num /= 10;
-    }
-
-    serial_puts(&buffer[idx]);
-}
-
-static int serial_received(void) {
-    return inb(COM1 + 5) & 0x01;
-}
-
-char serial_getc(void) {
-    while (!serial_received());
-    return inb(COM1);
+/* serial.c - Serial port driver (COM1) */
+#include "serial.h"
+#include "io.h"
+#include "spinlock.h"
+#include "idt.h"
+#include "pic.h"
+#include "process.h"
+#include "smp.h"
+
+#define COM1 0x3F8   /* I/O port base address for COM1 */
+
+#define IER_RDA   0x01   /* interrupt when a byte arrives */
+#define IER_THRE  0x02   /* interrupt when the transmit FIFO empties */
+#define LSR_DR    0x01   /* a received byte is waiting */
+#define LSR_THRE  0x20   /* transmit FIFO empty */
+#define LSR_TEMT  0x40   /* transmitter completely idle */
+#define UART_FIFO 16
+
+/*
+ * Output goes through a ring buffer. Writers copy bytes in and, if the
+ * UART's FIFO is empty, top it up; once serial_enable_irq() has run the
+ * THRE interrupt refills the FIFO 16 bytes at a time, so nobody waits
+ * on the wire. Before that (early boot) and after serial_force_sync()
+ * (panic) the ring is drained synchronously, as the old driver did.
+ * With the interrupt on, a writer that finds the ring full drops the
+ * byte and counts it rather than stall.
+ */
+static char tx_ring[SERIAL_TX_RING];
+static uint32_t tx_head;        /* next byte to send */
+static uint32_t tx_tail;        /* next free byte */
+static int tx_irq;              /* the THRE interrupt drains the ring */
+static uint8_t ier;             /* interrupt enable register shadow */
+
+static struct {
+    uint32_t bytes;
+    uint32_t dropped;
+    uint32_t irqs;
+} tx_stats;
+
+/*
+ * Input is cooked in the interrupt handler: printable characters are
+ * echoed and collected in rx_line, backspace takes one back, and Enter
+ * moves the finished line into rx_ring (each line ending in '\n') and
+ * wakes the reader. A process in serial_read_line() therefore sleeps
+ * until a whole line is there instead of polling the UART.
+ */
+static char rx_line[SERIAL_LINE_MAX];
+static uint32_t rx_len;
+static char rx_ring[SERIAL_RX_RING];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static volatile uint32_t rx_lines;  /* complete lines in rx_ring */
+static pcb_t *rx_waiter;
+
+static struct {
+    uint32_t bytes;
+    uint32_t lines;
+    uint32_t dropped;
+} rx_stats;
+
+/* Keeps lines from different CPUs from interleaving; also guards the
+   ring and is taken by the IRQ handler */
+static spinlock_t serial_lock = SPINLOCK_INIT;
+
+/*
+You can find more information here: https://caro.su/msx/ocm_de1/16550.pdf
+
+Your Keyboard
+    ↓
+Terminal (stdin)
+    ↓
+QEMU (-serial stdio)
+    ↓
+Emulated COM1 port (0x3F8)
+    ↓
+IRQ4: serial_irq() reads from COM1
+    ↓
+Your OS receives the character
+
+If you want real keyboard input, you'd need to add a keyboard driver.
+*/
+
+void serial_init(void) {
+    outb(COM1 + 1, 0x00);    /* Disable interrupts */
+    outb(COM1 + 3, 0x80);    /* Enable DLAB (set baud rate divisor) */
+    outb(COM1 + 0, 0x03);    /* Divisor low byte (38400 baud) */
+    outb(COM1 + 1, 0x00);    /* Divisor high byte */
+    outb(COM1 + 3, 0x03);    /* 8 bits, no parity, 1 stop bit */
+    outb(COM1 + 2, 0xC7);    /* Enable FIFO, clear, 14-byte threshold */
+    outb(COM1 + 4, 0x0B);    /* IRQs enabled, RTS/DSR set */
+}
+
+// --- Transmit Ring ---
+/* All of these run with serial_lock held */
+
+/* Hand the UART up to a FIFO's worth of bytes if it has room */
+static void tx_fill(void) {
+    if (!(inb(COM1 + 5) & LSR_THRE))
+        return;
+
+    for (int n = 0; n < UART_FIFO && tx_head != tx_tail; n++)
+        outb(COM1, tx_ring[tx_head++ & (SERIAL_TX_RING - 1)]);
+}
+
+/* Busy-wait until everything queued is in the UART */
+static void tx_drain(void) {
+    while (tx_head != tx_tail)
+        tx_fill();
+}
+
+static void set_ier(uint8_t value) {
+    if (ier != value) {
+        ier = value;
+        outb(COM1 + 1, ier);
+    }
+}
+
+static void tx_put(char c) {
+    if (tx_tail - tx_head == SERIAL_TX_RING) {
+        if (tx_irq) {
+            tx_stats.dropped++;
+            return;
+        }
+        tx_drain();
+    }
+
+    tx_ring[tx_tail++ & (SERIAL_TX_RING - 1)] = c;
+    tx_stats.bytes++;
+}
+
+/* After queueing: start the FIFO and let the interrupt do the rest */
+static void tx_kick(void) {
+    if (!tx_irq) {
+        tx_drain();
+        return;
+    }
+
+    tx_fill();
+    set_ier(tx_head != tx_tail ? ier | IER_THRE : ier & ~IER_THRE);
+}
+
+// --- Line Discipline ---
+/* One received byte; returns 1 if it finished a line. serial_lock held. */
+static int rx_input(char c) {
+    rx_stats.bytes++;
+
+    if (c == '\r' || c == '\n') {
+        tx_put('\r');
+        tx_put('\n');
+
+        if (SERIAL_RX_RING - (rx_tail - rx_head) <= rx_len) {
+            rx_stats.dropped += rx_len + 1;
+            rx_len = 0;
+            return 0;
+        }
+
+        for (uint32_t i = 0; i < rx_len; i++)
+            rx_ring[rx_tail++ & (SERIAL_RX_RING - 1)] = rx_line[i];
+        rx_ring[rx_tail++ & (SERIAL_RX_RING - 1)] = '\n';
+        rx_len = 0;
+        rx_lines++;
+        rx_stats.lines++;
+        return 1;
+    }
+
+    if ((c == '\b' || c == 0x7F) && rx_len > 0) {
+        rx_len--;
+        tx_put('\b');
+        tx_put(' ');
+        tx_put('\b');
+    } else if (c >= 32 && c < 127 && rx_len < SERIAL_LINE_MAX - 1) {
+        rx_line[rx_len++] = c;
+        tx_put(c);
+    }
+    return 0;
+}
+
+static int rx_line_ready(void) {
+    return rx_lines != 0;
+}
+
+static void serial_irq(regs_t *regs) {
+    pcb_t *wake = 0;
+    (void)regs;
+
+    spin_lock(&serial_lock);
+    (void)inb(COM1 + 2);        /* reading IIR acknowledges THRE */
+    tx_stats.irqs++;
+    while (inb(COM1 + 5) & LSR_DR) {
+        if (rx_input(inb(COM1)))
+            wake = rx_waiter;
+    }
+    tx_kick();
+    spin_unlock(&serial_lock);
+
+    /* Outside serial_lock: the scheduler logs under its own locks */
+    process_wake_event(wake);
+}
+
+/* Switch output and input over to IRQ4. It goes through the PIC to
+   CPU 0, so only call this once CPU 0 takes interrupts. */
+void serial_enable_irq(void) {
+    isr_register(IRQ_BASE + IRQ_COM1, serial_irq);
+
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    tx_irq = 1;
+    set_ier(ier | IER_RDA);
+    spin_unlock_irqrestore(&serial_lock, flags);
+
+    pic_unmask(IRQ_COM1);
+}
+
+/* Wait until every byte queued so far has left the UART */
+void serial_flush(void) {
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    tx_drain();
+    while (!(inb(COM1 + 5) & LSR_TEMT))
+        ;
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+/* Panic path: the other CPUs are halted, maybe with serial_lock held,
+   and this one takes no more interrupts. Forget the lock, write out
+   what is queued and stay synchronous from here on. */
+void serial_force_sync(void) {
+    spin_init(&serial_lock);
+    tx_irq = 0;
+    set_ier(ier & ~IER_THRE);
+    tx_drain();
+}
+
+void serial_putc(char c) {
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    if (c == '\n')
+        tx_put('\r');  /* Add carriage return */
+    tx_put(c);
+    tx_kick();
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+void serial_puts(const char* str) {
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    while (*str) {
+        if (*str == '\n')
+            tx_put('\r');
+        tx_put(*str++);
+    }
+    tx_kick();
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+/* Block until a whole line has been typed and copy it out without its
+   newline, cut to size - 1 characters and NUL-terminated. Returns the
+   length copied. Before serial_enable_irq() it polls the UART. */
+uint32_t serial_read_line(char *buf, uint32_t size) {
+    pcb_t *self = current_proc;
+    uint32_t n = 0;
+    char c;
+
+    uint32_t flags = spin_lock_irqsave(&serial_lock);
+    while (!rx_lines) {
+        if (!tx_irq || !self) {
+            while (!(inb(COM1 + 5) & LSR_DR))
+                cpu_relax();
+            rx_input(inb(COM1));
+            tx_kick();
+            continue;
+        }
+
+        rx_waiter = self;
+        spin_unlock_irqrestore(&serial_lock, flags);
+        process_wait_event(rx_line_ready);
+        flags = spin_lock_irqsave(&serial_lock);
+    }
+    rx_waiter = 0;
+
+    while ((c = rx_ring[rx_head++ & (SERIAL_RX_RING - 1)]) != '\n') {
+        if (n + 1 < size)
+            buf[n++] = c;
+    }
+    rx_lines--;
+    spin_unlock_irqrestore(&serial_lock, flags);
+
+    if (size)
+        buf[n] = '\0';
+    return n;
+}
+
+/* Print unsigned 32-bit number */
+void serial_put_num(uint32_t num) {
+    char buffer[12];
+    int idx = 11;
+    buffer[11] = '\0';
+
+    if (num == 0) {
+        serial_putc('0');
+        return;
+    }
+
+    while (num > 0 && idx > 0) {
+        buffer[--idx] = '0' + (num % 10);
+        num /= 10;
+    }
+
+    serial_puts(&buffer[idx]);
+}
+
+void serial_print_stats(void) {
+    serial_puts("Serial TX: ");
+    serial_put_num(tx_stats.bytes);
+    serial_puts(" bytes queued, ");
+    serial_put_num(tx_stats.dropped);
+    serial_puts(" dropped, ");
+    serial_put_num(tx_stats.irqs);
+    serial_puts(" interrupts (");
+    serial_puts(tx_irq ? "interrupt driven, " : "polled, ");
+    serial_put_num(SERIAL_TX_RING);
+    serial_puts(" byte ring)\n");
+
+    serial_puts("Serial RX: ");
+    serial_put_num(rx_stats.bytes);
+    serial_puts(" bytes, ");
+    serial_put_num(rx_stats.lines);
+    serial_puts(" lines, ");
+    serial_put_num(rx_stats.dropped);
+    serial_puts(" dropped\n");
 }
\ No newline at end of file
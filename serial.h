@@ -1,13 +1,21 @@
-/* serial.h - Serial port driver interface */
-#ifndef SERIAL_H
-#define SERIAL_H
-
-#include "types.h"
-
-void serial_init(void);
-void serial_putc(char c);
-void serial_puts(const char* str);
-void serial_put_num(uint32_t num);
-char serial_getc(void);
-
+/* serial.h - Serial port driver interface */
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "types.h"
+
+#define SERIAL_TX_RING 4096   /* bytes of queued output, a power of two */
+#define SERIAL_RX_RING 512    /* bytes of typed lines not read yet, ditto */
+#define SERIAL_LINE_MAX 128   /* longest line being edited */
+
+void serial_init(void);
+void serial_enable_irq(void);
+void serial_flush(void);
+void serial_force_sync(void);
+void serial_putc(char c);
+void serial_puts(const char* str);
+void serial_put_num(uint32_t num);
+uint32_t serial_read_line(char *buf, uint32_t size);
+void serial_print_stats(void);
+
 #endif
\ No newline at end of file
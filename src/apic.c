@@ -0,0 +1,284 @@
+// --- Local APIC ---
+#include "apic.h"
+#include "paging.h"
+#include "pit.h"
+#include "cpu.h"
+#include "serial.h"
+
+/*
+ * Each CPU has its own local APIC, all at the same physical address.
+ * The boot CPU keeps taking device IRQs through the 8259 (LINT0 in
+ * virtual wire mode); the APIC is used for the per-CPU timer on the
+ * application processors and for inter-processor interrupts. The CPUs
+ * themselves are found through the Intel MultiProcessor table the BIOS
+ * leaves in low memory.
+ */
+
+// --- Register Offsets ---
+#define LAPIC_ID          0x020
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ESR         0x280
+#define LAPIC_ICR_LOW     0x300
+#define LAPIC_ICR_HIGH    0x310
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_LVT_LINT0   0x350
+#define LAPIC_LVT_LINT1   0x360
+#define LAPIC_LVT_ERROR   0x370
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_CUR   0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define SVR_ENABLE        0x100
+#define LVT_MASKED        0x10000
+#define LVT_PERIODIC      0x20000
+#define LVT_EXTINT        0x700
+#define LVT_NMI           0x400
+#define TIMER_DIV_16      0x3
+
+#define ICR_INIT          0x500
+#define ICR_STARTUP       0x600
+#define ICR_ASSERT        0x4000
+#define ICR_LEVEL         0x8000
+#define ICR_PENDING       0x1000
+#define ICR_ALL_BUT_SELF  0xC0000
+
+#define CALIBRATE_US      10000
+
+static volatile uint32_t *lapic;
+
+static inline uint32_t lapic_read(uint32_t reg)
+{
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value)
+{
+    lapic[reg / 4] = value;
+}
+
+// --- MultiProcessor Table ---
+typedef struct {
+    char     signature[4];          /* "_MP_" */
+    uint32_t config;                /* physical address of the table */
+    uint8_t  length;                /* in 16-byte units */
+    uint8_t  revision;
+    uint8_t  checksum;
+    uint8_t  default_config;        /* non-zero: no table, a default setup */
+    uint32_t features;
+} __attribute__((packed)) mp_float_t;
+
+typedef struct {
+    char     signature[4];          /* "PCMP" */
+    uint16_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem[8];
+    char     product[12];
+    uint32_t oem_table;
+    uint16_t oem_size;
+    uint16_t entries;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t  ext_checksum;
+    uint8_t  reserved;
+} __attribute__((packed)) mp_config_t;
+
+typedef struct {
+    uint8_t  type;                  /* MP_ENTRY_CPU */
+    uint8_t  apic_id;
+    uint8_t  apic_version;
+    uint8_t  flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} __attribute__((packed)) mp_cpu_t;
+
+#define MP_ENTRY_CPU      0
+#define MP_CPU_ENABLED    0x01
+#define MP_CPU_BOOT       0x02
+
+static int checksum_ok(const void *addr, uint32_t len)
+{
+    const uint8_t *p = (const uint8_t*)addr;
+    uint8_t sum = 0;
+
+    while (len--)
+        sum += *p++;
+    return sum == 0;
+}
+
+static mp_float_t* mp_scan(uint32_t start, uint32_t len)
+{
+    for (uint32_t addr = start; addr + sizeof(mp_float_t) <= start + len; addr += 16)
+    {
+        mp_float_t *mp = (mp_float_t*)addr;
+
+        if (mp->signature[0] == '_' && mp->signature[1] == 'M' &&
+            mp->signature[2] == 'P' && mp->signature[3] == '_' &&
+            checksum_ok(mp, mp->length * 16))
+            return mp;
+    }
+    return 0;
+}
+
+/* The EBDA pointer lives in page 0, which is left unmapped to catch NULL
+   dereferences, so only the last KB of base memory and the BIOS ROM
+   are searched. That is where QEMU and Bochs put the table. */
+static mp_float_t* mp_find(void)
+{
+    mp_float_t *mp = mp_scan(0x9FC00, 0x400);
+
+    if (!mp)
+        mp = mp_scan(0xF0000, 0x10000);
+    return mp;
+}
+
+// --- Detection ---
+/* Fill `apic_ids` with the enabled CPUs, boot CPU first. Returns -1 if
+   there is no usable APIC, in which case the system stays uniprocessor. */
+int lapic_detect(uint8_t *apic_ids, uint32_t max, uint32_t *count)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    if (!(d & CPUID_EDX_APIC))
+        return -1;
+
+    mp_float_t *mp = mp_find();
+    if (!mp || !mp->config || mp->default_config)
+        return -1;
+
+    mp_config_t *cfg = (mp_config_t*)mp->config;
+    if (!paging_is_mapped(paging_kernel_dir(), mp->config) ||
+        cfg->signature[0] != 'P' || cfg->signature[1] != 'C' ||
+        cfg->signature[2] != 'M' || cfg->signature[3] != 'P' ||
+        !checksum_ok(cfg, cfg->length))
+        return -1;
+
+    uint32_t base = cfg->lapic_addr ? cfg->lapic_addr : LAPIC_DEFAULT_BASE;
+    if (paging_map(paging_kernel_dir(), base, base, PTE_WRITE | PTE_PCD) < 0)
+        return -1;
+    lapic = (volatile uint32_t*)base;
+
+    /* Processor entries are 20 bytes, everything else 8 */
+    uint8_t *entry = (uint8_t*)(cfg + 1);
+    uint32_t n = 1;
+
+    apic_ids[0] = lapic_id();
+    for (uint32_t i = 0; i < cfg->entries; i++)
+    {
+        if (*entry != MP_ENTRY_CPU)
+        {
+            entry += 8;
+            continue;
+        }
+
+        mp_cpu_t *cpu = (mp_cpu_t*)entry;
+        if ((cpu->flags & MP_CPU_ENABLED) && cpu->apic_id != apic_ids[0] && n < max)
+            apic_ids[n++] = cpu->apic_id;
+        entry += sizeof(mp_cpu_t);
+    }
+
+    *count = n;
+    return 0;
+}
+
+// --- Initialization ---
+/* Called on every CPU. Only the boot CPU passes the 8259 through. */
+void lapic_init(int boot_cpu)
+{
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_ERROR, LVT_MASKED);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT0, boot_cpu ? LVT_EXTINT : LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+    lapic_write(LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS);
+
+    /* The error status register needs a write before each read */
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_eoi();
+}
+
+uint32_t lapic_id(void)
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// --- Local APIC Timer ---
+/* APIC timer counts per scheduler tick, measured against the PIT */
+uint32_t lapic_timer_calibrate(void)
+{
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+
+    pit_delay_us(CALIBRATE_US);
+
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    return elapsed / (CALIBRATE_US / 1000) * 1000 / TIMER_HZ;
+}
+
+void lapic_timer_start(uint32_t count)
+{
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LVT_PERIODIC);
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/* Interrupt once after `count` counts; the counter then stays at 0 */
+void lapic_timer_oneshot(uint32_t count)
+{
+    lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, count);
+}
+
+/* Counts left in the current period */
+uint32_t lapic_timer_current(void)
+{
+    return lapic_read(LAPIC_TIMER_CUR);
+}
+
+// --- Inter-Processor Interrupts ---
+static void icr_send(uint32_t apic_id, uint32_t low)
+{
+    uint32_t flags = irq_save();
+
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, low);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING)
+        cpu_relax();
+
+    irq_restore(flags);
+}
+
+void lapic_send_init(uint32_t apic_id)
+{
+    icr_send(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    icr_send(apic_id, ICR_INIT | ICR_LEVEL);
+}
+
+/* The AP starts in real mode at physical address page * 4096 */
+void lapic_send_startup(uint32_t apic_id, uint32_t page)
+{
+    icr_send(apic_id, ICR_STARTUP | (page & 0xFF));
+}
+
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector)
+{
+    icr_send(apic_id, ICR_ASSERT | vector);
+}
+
+void lapic_send_ipi_others(uint8_t vector)
+{
+    icr_send(0, ICR_ALL_BUT_SELF | ICR_ASSERT | vector);
+}
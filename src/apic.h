@@ -0,0 +1,35 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include "types.h"
+
+// --- Local APIC Configuration ---
+#define LAPIC_DEFAULT_BASE  0xFEE00000  /* inside the MMIO window */
+
+#define LAPIC_TIMER_VECTOR  48
+#define LAPIC_KICK_VECTOR   49      /* reschedule IPI, wakes an idle CPU */
+#define LAPIC_HALT_VECTOR   50      /* stop this CPU for good */
+#define LAPIC_FLUSH_VECTOR  51      /* TLB shootdown, see paging.c */
+#define LAPIC_SPURIOUS      63      /* low nibble must be all ones */
+
+#define MAX_CPUS            8
+
+// --- Local APIC API ---
+int  lapic_detect(uint8_t *apic_ids, uint32_t max, uint32_t *count);
+void lapic_init(int boot_cpu);
+uint32_t lapic_id(void);
+void lapic_eoi(void);
+
+// --- Local APIC Timer ---
+uint32_t lapic_timer_calibrate(void);
+void lapic_timer_start(uint32_t count);
+void lapic_timer_oneshot(uint32_t count);
+uint32_t lapic_timer_current(void);
+
+// --- Inter-Processor Interrupts ---
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_startup(uint32_t apic_id, uint32_t page);
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+void lapic_send_ipi_others(uint8_t vector);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "types.h"
+
+// --- CPUID Feature Bits (leaf 1, EDX) ---
+#define CPUID_EDX_PSE   (1u << 3)
+#define CPUID_EDX_TSC   (1u << 4)
+#define CPUID_EDX_APIC  (1u << 9)
+#define CPUID_EDX_PGE   (1u << 13)
+
+// --- Control Register Bits ---
+#define CR4_PSE         (1u << 4)
+#define CR4_PGE         (1u << 7)
+
+// --- Privileged Instruction Wrappers ---
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    __asm__ volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* 64-by-32 bit divide with divl, as there is no libgcc; saturates when
+   the quotient does not fit in 32 bits (or d is 0) */
+static inline uint32_t div64_32(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t q;
+
+    if (hi >= d)
+        return 0xFFFFFFFF;
+    __asm__ ("divl %2" : "=a"(q), "+d"(hi) : "rm"(d), "a"((uint32_t)n) : "cc");
+    return q;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t val;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr3(uint32_t val) {
+    __asm__ volatile ("mov %0, %%cr3" : : "r"(val) : "memory");
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t val;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(val));
+    return val;
+}
+
+static inline void write_cr4(uint32_t val) {
+    __asm__ volatile ("mov %0, %%cr4" : : "r"(val) : "memory");
+}
+
+// --- Bit Scanning ---
+/* Index of the lowest set bit; `val` must be non-zero */
+static inline uint32_t bit_scan_forward(uint32_t val) {
+    uint32_t idx;
+    __asm__ ("bsf %1, %0" : "=r"(idx) : "rm"(val) : "cc");
+    return idx;
+}
+
+/* Index of the highest set bit; `val` must be non-zero */
+static inline uint32_t bit_scan_reverse(uint32_t val) {
+    uint32_t idx;
+    __asm__ ("bsr %1, %0" : "=r"(idx) : "rm"(val) : "cc");
+    return idx;
+}
+
+// --- Interrupt Flag ---
+/* Disable interrupts and return the previous EFLAGS for irq_restore() */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile ("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    __asm__ volatile ("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
+static inline void irq_enable(void) {
+    __asm__ volatile ("sti" : : : "memory");
+}
+
+// --- Spin-Wait Hint ---
+static inline void cpu_relax(void) {
+    __asm__ volatile ("pause" : : : "memory");
+}
+
+// --- Atomics ---
+/* Store `val` if *ptr still holds `old`; returns what *ptr held */
+static inline uint32_t cmpxchg(volatile uint32_t *ptr, uint32_t old, uint32_t val) {
+    __asm__ volatile ("lock; cmpxchgl %2, %1"
+                      : "+a"(old), "+m"(*ptr) : "r"(val) : "memory", "cc");
+    return old;
+}
+
+/* Full fence: orders an earlier store before a later load, which x86
+   otherwise does not */
+static inline void memory_barrier(void) {
+    __asm__ volatile ("lock; addl $0, (%%esp)" : : : "memory", "cc");
+}
+
+static inline void atomic_inc(volatile uint32_t *ptr) {
+    __asm__ volatile ("lock; incl %0" : "+m"(*ptr) : : "memory", "cc");
+}
+
+static inline void atomic_dec(volatile uint32_t *ptr) {
+    __asm__ volatile ("lock; decl %0" : "+m"(*ptr) : : "memory", "cc");
+}
+
+#endif
@@ -0,0 +1,131 @@
+// --- Global Descriptor Table ---
+#include "gdt.h"
+#include "serial.h"
+
+/*
+ * Flat 4GB code and data segments plus two TSSs. The kernel TSS only
+ * exists so the CPU has somewhere to store state during a hardware task
+ * switch; the double-fault TSS gives #DF its own known-good stack, which
+ * is what lets a stack overflow into a guard page be reported instead of
+ * triple-faulting the machine. Each CPU also gets a small data segment
+ * based at its cpu_t, loaded into %gs, which is how this_cpu() finds it.
+ *
+ * Every CPU loads its own copy of the table, in which the two TSS
+ * selectors name its own TSSs: the #DF task gate in the shared IDT can
+ * only give one selector, and a TSS is busy while its task runs, so two
+ * CPUs cannot share one.
+ */
+
+typedef struct {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t  base_mid;
+    uint8_t  access;
+    uint8_t  granularity;
+    uint8_t  base_high;
+} __attribute__((packed)) gdt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+static gdt_entry_t gdt[GDT_PERCPU_MAX][GDT_ENTRIES];
+static gdt_ptr_t gdt_ptr[GDT_PERCPU_MAX];
+
+static tss_t kernel_tss[GDT_PERCPU_MAX];
+static tss_t dfault_tss[GDT_PERCPU_MAX];
+
+static uint8_t dfault_stack[GDT_PERCPU_MAX][4096] __attribute__((aligned(16)));
+static uint32_t dfault_cr3;
+
+extern void double_fault_task(void);
+
+// --- Helper Functions ---
+static void gdt_set_entry(uint32_t cpu, int idx, uint32_t base, uint32_t limit,
+                          uint8_t access, uint8_t gran)
+{
+    gdt_entry_t *e = &gdt[cpu][idx];
+
+    e->limit_low = limit & 0xFFFF;
+    e->base_low = base & 0xFFFF;
+    e->base_mid = (base >> 16) & 0xFF;
+    e->access = access;
+    e->granularity = ((limit >> 16) & 0x0F) | (gran & 0xF0);
+    e->base_high = (base >> 24) & 0xFF;
+}
+
+/* Fill in the table and TSSs of `cpu`, then load them on the calling CPU */
+static void gdt_setup(uint32_t cpu)
+{
+    tss_t *tss = &kernel_tss[cpu];
+    tss_t *df = &dfault_tss[cpu];
+
+    gdt_set_entry(cpu, 0, 0, 0, 0, 0);
+    gdt_set_entry(cpu, 1, 0, 0xFFFFF, 0x9A, 0xC0);     /* ring 0 code */
+    gdt_set_entry(cpu, 2, 0, 0xFFFFF, 0x92, 0xC0);     /* ring 0 data */
+    gdt_set_entry(cpu, 3, (uint32_t)tss, sizeof(tss_t) - 1, 0x89, 0x00);
+    gdt_set_entry(cpu, 4, (uint32_t)df, sizeof(tss_t) - 1, 0x89, 0x00);
+
+    tss->ss0 = KERNEL_DATA_SEL;
+    tss->iomap_base = sizeof(tss_t);
+
+    /* %gs as set by gdt_set_percpu(), so panic() still knows the CPU */
+    df->eip = (uint32_t)double_fault_task;
+    df->esp = (uint32_t)(dfault_stack[cpu] + sizeof(dfault_stack[cpu]));
+    df->eflags = 0x2;
+    df->cr3 = dfault_cr3;
+    df->cs = KERNEL_CODE_SEL;
+    df->ds = df->es = df->ss = df->fs = KERNEL_DATA_SEL;
+    df->gs = PERCPU_SEL(cpu);
+    df->iomap_base = sizeof(tss_t);
+
+    gdt_ptr[cpu].limit = sizeof(gdt[cpu]) - 1;
+    gdt_ptr[cpu].base = (uint32_t)gdt[cpu];
+
+    __asm__ volatile(
+        "lgdt %0\n"
+        "ljmp %1, $1f\n"
+        "1:\n"
+        "mov %2, %%ax\n"
+        "mov %%ax, %%ds\n"
+        "mov %%ax, %%es\n"
+        "mov %%ax, %%fs\n"
+        "mov %%ax, %%gs\n"
+        "mov %%ax, %%ss\n"
+        "mov %3, %%ax\n"
+        "ltr %%ax\n"
+        : : "m"(gdt_ptr[cpu]), "i"(KERNEL_CODE_SEL), "i"(KERNEL_DATA_SEL),
+            "i"(KERNEL_TSS_SEL)
+        : "eax", "memory");
+}
+
+// --- Initialization ---
+void gdt_init(void)
+{
+    gdt_setup(0);
+    serial_puts("[gdt] loaded flat segments and TSS\n");
+}
+
+/* An application processor gets its own table and TSSs */
+void gdt_load_ap(uint32_t cpu)
+{
+    gdt_setup(cpu);
+}
+
+/* Point %gs of the calling CPU at its per-CPU block */
+void gdt_set_percpu(uint32_t cpu, void *base, uint32_t size)
+{
+    gdt_set_entry(cpu, GDT_PERCPU_FIRST + cpu, (uint32_t)base, size - 1, 0x92, 0x40);
+
+    __asm__ volatile("mov %0, %%gs" : : "r"(PERCPU_SEL(cpu)) : "memory");
+}
+
+/* The double-fault task switches CR3 too, so it needs the kernel
+   directory; APs set up after this pick it up in gdt_setup() */
+void gdt_set_dfault_cr3(uint32_t cr3)
+{
+    dfault_cr3 = cr3;
+    for (uint32_t i = 0; i < GDT_PERCPU_MAX; i++)
+        dfault_tss[i].cr3 = cr3;
+}
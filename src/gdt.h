@@ -0,0 +1,35 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include "types.h"
+
+// --- Segment Selectors ---
+#define KERNEL_CODE_SEL  0x08
+#define KERNEL_DATA_SEL  0x10
+#define KERNEL_TSS_SEL   0x18
+#define DFAULT_TSS_SEL   0x20
+
+#define GDT_PERCPU_FIRST 5      /* one data segment per CPU, for %gs */
+#define GDT_PERCPU_MAX   8
+#define GDT_ENTRIES      (GDT_PERCPU_FIRST + GDT_PERCPU_MAX)
+#define PERCPU_SEL(cpu)  ((GDT_PERCPU_FIRST + (cpu)) << 3)
+
+// --- Task State Segment ---
+typedef struct {
+    uint32_t prev_task;
+    uint32_t esp0, ss0, esp1, ss1, esp2, ss2;
+    uint32_t cr3;
+    uint32_t eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap, iomap_base;
+} __attribute__((packed)) tss_t;
+
+// --- GDT API ---
+void gdt_init(void);
+void gdt_load_ap(uint32_t cpu);
+void gdt_set_percpu(uint32_t cpu, void *base, uint32_t size);
+void gdt_set_dfault_cr3(uint32_t cr3);
+
+#endif
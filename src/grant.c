@@ -0,0 +1,269 @@
+// --- Zero-Copy Page Grants ---
+#include "grant.h"
+#include "process.h"
+#include "paging.h"
+#include "pmm.h"
+#include "slab.h"
+#include "spinlock.h"
+#include "serial.h"
+#include "log.h"
+#include "smp.h"
+
+/*
+ * The first GRANT_SLOTS * GRANT_SPAN bytes of every private window are
+ * cut into fixed slots, and slot i of a process maps whatever grant
+ * sits in pcb->grants[i]. Handing a grant to another process maps the
+ * same frames into a free slot of the receiver and bumps `refs`; each
+ * holder drops its own reference with grant_free(), and whoever drops
+ * the last one frees the frames, so they are freed exactly once.
+ *
+ * Mappings are only ever removed from the running process's own window
+ * or from one that is not running anywhere (a rolled back send, a dead
+ * process), and private entries are not global, so a local invlpg is
+ * all the TLB needs: any other CPU that ran the process has reloaded
+ * CR3 since.
+ */
+
+struct grant
+{
+    uint32_t frames;            /* physical base of a contiguous run */
+    uint32_t pages;
+    uint32_t size;              /* bytes asked for at grant_alloc() */
+    uint32_t refs;              /* address spaces it is mapped into */
+};
+
+#define GRANT_SPAN  (GRANT_MAX_PAGES * PAGE_SIZE)
+#define GRANT_END   (PRIVATE_BASE + GRANT_SLOTS * GRANT_SPAN)
+
+static kmem_cache_t *grant_cache;
+
+/* Grant tables and their window mappings; a sender maps into the
+   receiver's table from another CPU while the receiver works on it */
+static spinlock_t grant_lock = SPINLOCK_INIT;
+
+static struct {
+    uint32_t live;
+    uint32_t pages;
+    uint32_t allocs;
+    uint32_t sends;
+    uint32_t frees;
+} grant_stats;
+
+// --- Helper Functions ---
+static inline uint32_t slot_vaddr(uint32_t slot)
+{
+    return PRIVATE_BASE + slot * GRANT_SPAN;
+}
+
+/* Slot a grant_alloc()/process_receive() address stands for, or -1 */
+static int vaddr_slot(uint32_t vaddr)
+{
+    if (vaddr < PRIVATE_BASE || vaddr >= GRANT_END || (vaddr & (GRANT_SPAN - 1)))
+        return -1;
+    return (vaddr - PRIVATE_BASE) / GRANT_SPAN;
+}
+
+static grant_t* lookup_locked(pcb_t *p, uint32_t vaddr)
+{
+    int slot = vaddr_slot(vaddr);
+
+    return slot < 0 ? 0 : p->grants[slot];
+}
+
+/* Map `g` into a free slot of `p`; returns its address there, 0 if
+   the table is full or a page table cannot be allocated */
+static uint32_t map_locked(pcb_t *p, grant_t *g)
+{
+    uint32_t slot;
+
+    for (slot = 0; slot < GRANT_SLOTS; slot++)
+    {
+        if (!p->grants[slot])
+            break;
+    }
+    if (slot == GRANT_SLOTS)
+        return 0;
+
+    uint32_t vaddr = slot_vaddr(slot);
+    for (uint32_t i = 0; i < g->pages; i++)
+    {
+        if (paging_map(p->page_dir, vaddr + i * PAGE_SIZE,
+                       g->frames + i * PAGE_SIZE, PTE_WRITE) < 0)
+        {
+            while (i-- > 0)
+                paging_unmap(p->page_dir, vaddr + i * PAGE_SIZE);
+            return 0;
+        }
+    }
+
+    p->grants[slot] = g;
+    g->refs++;
+    return vaddr;
+}
+
+static void unmap_locked(pcb_t *p, uint32_t slot)
+{
+    grant_t *g = p->grants[slot];
+    uint32_t vaddr = slot_vaddr(slot);
+
+    for (uint32_t i = 0; i < g->pages; i++)
+        paging_unmap(p->page_dir, vaddr + i * PAGE_SIZE);
+    p->grants[slot] = 0;
+
+    if (--g->refs > 0)
+        return;
+
+    pmm_free_pages((void*)g->frames, g->pages);
+    grant_stats.live--;
+    grant_stats.pages -= g->pages;
+    grant_stats.frees++;
+    kmem_cache_free(grant_cache, g);
+}
+
+// --- Initialization ---
+void grant_init(void)
+{
+    grant_cache = kmem_cache_create("grant", sizeof(grant_t), 0, 0);
+}
+
+// --- Allocation ---
+/* Pages for the running process to fill and send; contents are
+   undefined, as with kmalloc(). 0 if `size` is 0 or over GRANT_SPAN. */
+void* grant_alloc(uint32_t size)
+{
+    pcb_t *self = current_proc;
+
+    if (!self || size == 0 || size > GRANT_SPAN)
+        return 0;
+
+    uint32_t pages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    grant_t *g = kmem_cache_alloc(grant_cache);
+    uint8_t *frames = g ? pmm_alloc_pages(pages) : 0;
+    uint32_t vaddr = 0;
+
+    if (frames)
+    {
+        for (uint32_t i = 0; i < pages; i++)
+            pmm_page(frames + i * PAGE_SIZE)->type = PAGE_TYPE_GRANT;
+
+        g->frames = (uint32_t)frames;
+        g->pages = pages;
+        g->size = size;
+        g->refs = 0;
+
+        uint32_t flags = spin_lock_irqsave(&grant_lock);
+        vaddr = map_locked(self, g);
+        if (vaddr)
+        {
+            grant_stats.live++;
+            grant_stats.pages += pages;
+            grant_stats.allocs++;
+        }
+        spin_unlock_irqrestore(&grant_lock, flags);
+    }
+
+    if (vaddr)
+        return (void*)vaddr;
+
+    if (frames)
+        pmm_free_pages(frames, pages);
+    if (g)
+        kmem_cache_free(grant_cache, g);
+    return 0;
+}
+
+/* Drop the running process's mapping of `buf` */
+void grant_free(void *buf)
+{
+    pcb_t *self = current_proc;
+    int slot = vaddr_slot((uint32_t)buf);
+
+    if (!self)
+        return;
+
+    uint32_t flags = spin_lock_irqsave(&grant_lock);
+    if (slot >= 0 && self->grants[slot])
+        unmap_locked(self, slot);
+    else
+        klog(LOG_WARN, LOG_IPC, "[grant] WARNING: free of address not holding a grant\n");
+    spin_unlock_irqrestore(&grant_lock, flags);
+}
+
+/* Bytes in the grant at `buf`, 0 if the running process holds none there */
+uint32_t grant_size(const void *buf)
+{
+    pcb_t *self = current_proc;
+    uint32_t size = 0;
+
+    if (!self)
+        return 0;
+
+    uint32_t flags = spin_lock_irqsave(&grant_lock);
+    grant_t *g = lookup_locked(self, (uint32_t)buf);
+    if (g)
+        size = g->size;
+    spin_unlock_irqrestore(&grant_lock, flags);
+    return size;
+}
+
+// --- Transfer ---
+/* Map the running process's grant at `buf` into `dest` as well; returns
+   the address it got there, 0 if `buf` is no grant or `dest` has no
+   free slot */
+uint32_t grant_map_into(pcb_t *dest, const void *buf)
+{
+    pcb_t *self = current_proc;
+    uint32_t vaddr = 0;
+
+    if (!self)
+        return 0;
+
+    uint32_t flags = spin_lock_irqsave(&grant_lock);
+    grant_t *g = lookup_locked(self, (uint32_t)buf);
+    if (g)
+        vaddr = map_locked(dest, g);
+    if (vaddr)
+        grant_stats.sends++;
+    spin_unlock_irqrestore(&grant_lock, flags);
+    return vaddr;
+}
+
+/* Undo a grant_map_into() whose message never went out */
+void grant_drop(pcb_t *p, uint32_t vaddr)
+{
+    int slot = vaddr_slot(vaddr);
+
+    uint32_t flags = spin_lock_irqsave(&grant_lock);
+    if (slot >= 0 && p->grants[slot])
+        unmap_locked(p, slot);
+    spin_unlock_irqrestore(&grant_lock, flags);
+}
+
+/* A reclaimed process lets go of everything it held, including grants
+   still sitting unread in its mailbox */
+void grant_release_all(pcb_t *p)
+{
+    uint32_t flags = spin_lock_irqsave(&grant_lock);
+    for (uint32_t slot = 0; slot < GRANT_SLOTS; slot++)
+    {
+        if (p->grants[slot])
+            unmap_locked(p, slot);
+    }
+    spin_unlock_irqrestore(&grant_lock, flags);
+}
+
+// --- Statistics ---
+void grant_print_stats(void)
+{
+    serial_puts("Grants: ");
+    serial_put_num(grant_stats.live);
+    serial_puts(" live (");
+    serial_put_num(grant_stats.pages);
+    serial_puts(" pages), ");
+    serial_put_num(grant_stats.allocs);
+    serial_puts(" allocated, ");
+    serial_put_num(grant_stats.sends);
+    serial_puts(" sent, ");
+    serial_put_num(grant_stats.frees);
+    serial_puts(" freed\n");
+}
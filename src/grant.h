@@ -0,0 +1,39 @@
+#ifndef GRANT_H
+#define GRANT_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define GRANT_SLOTS       16        /* grants one process can hold at once */
+#define GRANT_MAX_PAGES   16        /* 64KB per grant */
+
+// --- Send Modes ---
+#define GRANT_MOVE        0         /* the sender gives up its mapping */
+#define GRANT_SHARE       1         /* both sides keep the pages mapped */
+
+// --- Page Grant ---
+/*
+ * A run of page frames that moves between address spaces by being
+ * mapped, never copied. Every process holding it has it mapped in one
+ * slot of its private window; the frames go back to the allocator when
+ * the last of those mappings is dropped.
+ */
+typedef struct grant grant_t;
+
+struct pcb;
+
+// --- Grant API ---
+/* For the running process */
+void  grant_init(void);
+void* grant_alloc(uint32_t size);
+void  grant_free(void *buf);
+uint32_t grant_size(const void *buf);
+
+/* For the IPC layer: `dest` must be pinned */
+uint32_t grant_map_into(struct pcb *dest, const void *buf);
+void  grant_drop(struct pcb *p, uint32_t vaddr);
+void  grant_release_all(struct pcb *p);
+
+void  grant_print_stats(void);
+
+#endif
@@ -0,0 +1,151 @@
+// --- Interrupt Descriptor Table ---
+#include "idt.h"
+#include "gdt.h"
+#include "pic.h"
+#include "smp.h"
+#include "serial.h"
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t  zero;
+    uint8_t  type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+static idt_entry_t idt[IDT_ENTRIES];
+static idt_ptr_t idt_ptr;
+static isr_handler_t handlers[IDT_ENTRIES];
+
+extern uint32_t isr_stub_table[NUM_STUBS];
+
+static const char *exception_names[NUM_EXCEPTIONS] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow",
+    "bound range", "invalid opcode", "device not available",
+    "double fault", "coprocessor overrun", "invalid TSS",
+    "segment not present", "stack fault", "general protection",
+    "page fault", "reserved", "x87 error", "alignment check",
+    "machine check", "SIMD error", "virtualization", "control protection",
+    "reserved", "reserved", "reserved", "reserved", "reserved", "reserved",
+    "reserved", "reserved", "security", "reserved"
+};
+
+// --- Gate Setup ---
+void idt_set_gate(uint8_t vec, void (*handler)(void))
+{
+    uint32_t addr = (uint32_t)handler;
+
+    idt[vec].offset_low = addr & 0xFFFF;
+    idt[vec].selector = KERNEL_CODE_SEL;
+    idt[vec].zero = 0;
+    idt[vec].type_attr = 0x8E;          /* present, ring 0, 32-bit interrupt gate */
+    idt[vec].offset_high = (addr >> 16) & 0xFFFF;
+}
+
+static void idt_set_task_gate(uint8_t vec, uint16_t tss_sel)
+{
+    idt[vec].offset_low = 0;
+    idt[vec].selector = tss_sel;
+    idt[vec].zero = 0;
+    idt[vec].type_attr = 0x85;          /* present, task gate */
+    idt[vec].offset_high = 0;
+}
+
+void isr_register(uint8_t vec, isr_handler_t handler)
+{
+    handlers[vec] = handler;
+}
+
+// --- Initialization ---
+void idt_init(void)
+{
+    for (int i = 0; i < NUM_STUBS; i++)
+        idt_set_gate(i, (void (*)(void))isr_stub_table[i]);
+
+    /* #DF runs as its own task so it gets a fresh stack even when the
+       fault was caused by running off the end of the current one */
+    idt_set_task_gate(VEC_DOUBLE_FAULT, DFAULT_TSS_SEL);
+
+    idt_ptr.limit = sizeof(idt) - 1;
+    idt_ptr.base = (uint32_t)idt;
+
+    idt_load();
+
+    serial_puts("[idt] loaded (");
+    serial_put_num(NUM_EXCEPTIONS);
+    serial_puts(" exception handlers)\n");
+}
+
+/* Every CPU loads the same table */
+void idt_load(void)
+{
+    __asm__ volatile("lidt %0" : : "m"(idt_ptr));
+}
+
+// --- Fault Reporting ---
+void panic(const char *msg)
+{
+    __asm__ volatile("cli");
+    smp_halt_others();
+    serial_force_sync();
+    serial_puts("\n[PANIC] ");
+    serial_puts(msg);
+    serial_puts("\nSystem halted.\n");
+    for (;;)
+        __asm__ volatile("hlt");
+}
+
+/* Called from isr_common with a pointer to the saved frame */
+void isr_dispatch(regs_t *regs)
+{
+    if (regs->int_no >= IRQ_BASE && regs->int_no < IRQ_BASE + NUM_IRQS)
+    {
+        uint8_t irq = regs->int_no - IRQ_BASE;
+
+        if (pic_is_spurious(irq))
+            return;
+
+        /* EOI first: the handler may switch to another process and only
+           come back here much later. IF stays clear until iret. */
+        pic_send_eoi(irq);
+
+        if (handlers[regs->int_no])
+            handlers[regs->int_no](regs);
+        return;
+    }
+
+    if (handlers[regs->int_no])
+    {
+        handlers[regs->int_no](regs);
+        return;
+    }
+
+    if (regs->int_no < NUM_EXCEPTIONS)
+    {
+        serial_puts("\n[idt] EXCEPTION: ");
+        serial_puts(exception_names[regs->int_no]);
+        serial_puts(" at EIP=");
+        serial_put_num(regs->eip);
+        serial_puts(" err=");
+        serial_put_num(regs->err_code);
+        panic("unhandled CPU exception");
+    }
+}
+
+/* Entry point of the double-fault task (see gdt.c) */
+void double_fault_task(void)
+{
+    uint32_t cr2;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    serial_puts("\n[idt] DOUBLE FAULT (last fault address ");
+    serial_put_num(cr2);
+    serial_puts(")\n");
+    serial_puts("[idt] most likely a kernel stack overflow into a guard page\n");
+    panic("double fault");
+}
@@ -0,0 +1,33 @@
+#ifndef IDT_H
+#define IDT_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define IDT_ENTRIES      256
+#define NUM_EXCEPTIONS   32
+#define NUM_STUBS        64     /* exceptions, 16 PIC IRQs, local APIC */
+
+#define VEC_DOUBLE_FAULT 8
+#define VEC_PAGE_FAULT   14
+
+// --- Saved Register Frame (built by src/isr.S) ---
+typedef struct {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
+    uint32_t int_no, err_code;
+    uint32_t eip, cs, eflags;
+} regs_t;
+
+typedef void (*isr_handler_t)(regs_t *regs);
+
+// --- IDT API ---
+void idt_init(void);
+void idt_load(void);
+void idt_set_gate(uint8_t vec, void (*handler)(void));
+void isr_register(uint8_t vec, isr_handler_t handler);
+
+// --- Fault Reporting ---
+void panic(const char *msg);
+
+#endif
@@ -0,0 +1,100 @@
+// --- Log Filtering ---
+#include "log.h"
+
+uint32_t log_level = LOG_LEVEL;
+uint32_t log_mask = LOG_ALL;
+
+static const char *level_names[] = { "trace", "debug", "info", "warn", "error" };
+
+static const struct {
+    const char *name;
+    uint32_t bit;
+} subsystems[] = {
+    { "mem",   LOG_MEM },
+    { "slab",  LOG_SLAB },
+    { "proc",  LOG_PROC },
+    { "ipc",   LOG_IPC },
+    { "sched", LOG_SCHED },
+};
+
+#define NUM_LEVELS      (sizeof(level_names) / sizeof(level_names[0]))
+#define NUM_SUBSYSTEMS  (sizeof(subsystems) / sizeof(subsystems[0]))
+
+// --- Settings ---
+/* `input` starts with `word`, followed by a space or the end */
+static int word_is(const char *input, const char *word)
+{
+    while (*word)
+    {
+        if (*input++ != *word++)
+            return 0;
+    }
+    return *input == ' ' || *input == '\0';
+}
+
+/* Levels below the build's LOG_LEVEL were compiled out and cannot be
+   turned back on */
+static int set_level(const char *name)
+{
+    for (uint32_t i = 0; i < NUM_LEVELS; i++)
+    {
+        if (word_is(name, level_names[i]))
+        {
+            if ((int)i < LOG_LEVEL)
+                return -1;
+            log_level = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* "LEVEL" sets the threshold; "SUBSYSTEM on|off" (or "all on|off")
+   switches a subsystem. Returns -1 if `args` is neither. */
+int log_configure(const char *args)
+{
+    const char *state = args;
+    uint32_t bits = 0;
+
+    if (set_level(args) == 0)
+        return 0;
+
+    while (*state && *state != ' ')
+        state++;
+    while (*state == ' ')
+        state++;
+
+    if (word_is(args, "all"))
+        bits = LOG_ALL;
+    for (uint32_t i = 0; i < NUM_SUBSYSTEMS; i++)
+    {
+        if (word_is(args, subsystems[i].name))
+            bits = subsystems[i].bit;
+    }
+
+    if (!bits)
+        return -1;
+    if (word_is(state, "on"))
+        log_mask |= bits;
+    else if (word_is(state, "off"))
+        log_mask &= ~bits;
+    else
+        return -1;
+    return 0;
+}
+
+void log_print_settings(void)
+{
+    serial_puts("Log level: ");
+    serial_puts(level_names[log_level]);
+    serial_puts(" (built with ");
+    serial_puts(level_names[LOG_LEVEL]);
+    serial_puts(")\nSubsystems:");
+    for (uint32_t i = 0; i < NUM_SUBSYSTEMS; i++)
+    {
+        serial_puts(" ");
+        serial_puts(subsystems[i].name);
+        serial_puts(log_mask & subsystems[i].bit ? "=on" : "=off");
+    }
+    serial_puts("\n");
+}
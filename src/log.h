@@ -0,0 +1,51 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "types.h"
+#include "serial.h"
+
+// --- Levels ---
+#define LOG_TRACE   0       /* every allocation and free */
+#define LOG_DEBUG   1
+#define LOG_INFO    2       /* process lifecycle, configuration changes */
+#define LOG_WARN    3
+#define LOG_ERROR   4
+
+/* Build-time floor, from the Makefile: anything below it is compiled out */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_INFO
+#endif
+
+// --- Subsystems ---
+#define LOG_MEM     (1u << 0)
+#define LOG_SLAB    (1u << 1)
+#define LOG_PROC    (1u << 2)
+#define LOG_IPC     (1u << 3)
+#define LOG_SCHED   (1u << 4)
+#define LOG_ALL     0x1Fu
+
+// --- Runtime Filter ---
+/* Set from the loglevel shell command */
+extern uint32_t log_level;
+extern uint32_t log_mask;
+
+/*
+ * Guards a message built from serial_puts()/serial_put_num() calls:
+ *
+ *     if (log_on(LOG_DEBUG, LOG_MEM)) { ... }
+ *
+ * `level` is a constant, so below LOG_LEVEL the condition folds to 0
+ * and the whole block, loads of the runtime filter included, is gone.
+ */
+#define log_on(level, sys) \
+    ((level) >= LOG_LEVEL && (level) >= log_level && (log_mask & (sys)))
+
+/* A message that is a single string */
+#define klog(level, sys, msg) \
+    do { if (log_on(level, sys)) serial_puts(msg); } while (0)
+
+// --- Log Control API ---
+int  log_configure(const char *args);
+void log_print_settings(void);
+
+#endif
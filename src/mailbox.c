@@ -0,0 +1,231 @@
+// --- Lock-Free IPC Mailboxes ---
+#include "mailbox.h"
+#include "memory.h"
+#include "slab.h"
+#include "cpu.h"
+
+/*
+ * The ring is the bounded queue from Dmitry Vyukov, cut down to a single
+ * consumer. Slot i starts with seq == i. A sender that sees
+ * seq == pos for the slot at `tail` owns it once its cmpxchg moves `tail`
+ * past pos; it fills in the message and publishes it with seq = pos + 1.
+ * The owner reads the slot at `head` once seq == head + 1 and hands it
+ * back to the senders a lap later with seq = head + capacity.
+ *
+ * A sender that sees seq behind pos is looking at a slot the owner has
+ * not drained yet, so the ring is full. A receive never waits: a slot
+ * that is claimed but not yet published simply reads as empty.
+ *
+ * x86 keeps stores in order and loads in order, so the compiler barriers
+ * are the only fences needed between the payload and the sequence word.
+ */
+
+/* Mailboxes of the default size come from their own slab cache; others
+   are rare and come from the heap */
+static kmem_cache_t *slot_cache;
+
+#define barrier()  __asm__ volatile("" : : : "memory")
+
+// --- Setup ---
+void mailbox_init(void)
+{
+    slot_cache = kmem_cache_create("mailbox", MAILBOX_DEFAULT * sizeof(mbox_slot_t), 0, 0);
+}
+
+static uint32_t round_capacity(uint32_t size)
+{
+    uint32_t cap = 1;
+
+    if (size == 0)
+        size = MAILBOX_DEFAULT;
+    if (size > MAILBOX_MAX)
+        size = MAILBOX_MAX;
+    while (cap < size)
+        cap <<= 1;
+    return cap;
+}
+
+/* Empty the mailbox and size it for `size` messages. A buffer of the
+   right capacity from an earlier owner of the PCB is reused as is. No
+   sender may be able to reach the mailbox while this runs. */
+int mailbox_setup(mailbox_t *mb, uint32_t size)
+{
+    uint32_t cap = round_capacity(size);
+
+    if (mb->slots && mailbox_capacity(mb) != cap)
+        mailbox_release(mb);
+
+    if (!mb->slots)
+    {
+        if (cap == MAILBOX_DEFAULT)
+            mb->slots = kmem_cache_alloc(slot_cache);
+        else
+            mb->slots = kmalloc(cap * sizeof(mbox_slot_t));
+        if (!mb->slots)
+            return -1;
+        mb->mask = cap - 1;
+    }
+
+    for (uint32_t i = 0; i < cap; i++)
+        mb->slots[i].seq = i;
+    mb->head = 0;
+    mb->tail = 0;
+    return 0;
+}
+
+void mailbox_release(mailbox_t *mb)
+{
+    if (!mb->slots)
+        return;
+
+    if (mailbox_capacity(mb) == MAILBOX_DEFAULT)
+        kmem_cache_free(slot_cache, mb->slots);
+    else
+        kfree(mb->slots);
+    mb->slots = 0;
+    mb->mask = 0;
+}
+
+// --- Send and Receive ---
+/* Any CPU, any number of senders at once; -1 if the mailbox is full */
+int mailbox_push(mailbox_t *mb, const message_t *msg)
+{
+    uint32_t pos = mb->tail;
+    mbox_slot_t *slot;
+
+    for (;;)
+    {
+        slot = &mb->slots[pos & mb->mask];
+        int32_t diff = (int32_t)(slot->seq - pos);
+
+        if (diff == 0)
+        {
+            uint32_t seen = cmpxchg(&mb->tail, pos, pos + 1);
+            if (seen == pos)
+                break;
+            pos = seen;
+        }
+        else if (diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            /* Another sender took this slot since we read tail */
+            pos = mb->tail;
+        }
+    }
+
+    slot->msg = *msg;
+    barrier();
+    slot->seq = pos + 1;
+    return 0;
+}
+
+/* Claim up to `count` consecutive slots with one cmpxchg and fill them
+   from `values`. The owner drains in order, so if the last slot of the
+   run is free all the ones before it are too. Returns how many went in;
+   0 if the mailbox is full. */
+uint32_t mailbox_push_batch(mailbox_t *mb, uint32_t sender_pid,
+                            const uint32_t *values, uint32_t count)
+{
+    uint32_t cap = mailbox_capacity(mb);
+    uint32_t pos = mb->tail;
+    uint32_t n;
+
+    if (count == 0)
+        return 0;
+    if (count > cap)
+        count = cap;
+
+    for (;;)
+    {
+        int32_t diff = (int32_t)(mb->slots[pos & mb->mask].seq - pos);
+
+        if (diff < 0)
+            return 0;
+        if (diff > 0)
+        {
+            pos = mb->tail;
+            continue;
+        }
+
+        n = count;
+        while (n > 1 && mb->slots[(pos + n - 1) & mb->mask].seq != pos + n - 1)
+            n--;
+
+        uint32_t seen = cmpxchg(&mb->tail, pos, pos + n);
+        if (seen == pos)
+            break;
+        pos = seen;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mbox_slot_t *slot = &mb->slots[(pos + i) & mb->mask];
+        slot->msg.sender_pid = sender_pid;
+        slot->msg.value = values[i];
+        slot->msg.reply_cap = 0;
+    }
+    barrier();
+    for (uint32_t i = 0; i < n; i++)
+        mb->slots[(pos + i) & mb->mask].seq = pos + i + 1;
+    return n;
+}
+
+/* Owner only; wait-free. -1 if there is no published message. */
+int mailbox_pop(mailbox_t *mb, message_t *out)
+{
+    mbox_slot_t *slot = &mb->slots[mb->head & mb->mask];
+
+    if (slot->seq != mb->head + 1)
+        return -1;
+
+    barrier();
+    *out = slot->msg;
+    barrier();
+    slot->seq = mb->head + mb->mask + 1;
+    mb->head++;
+    return 0;
+}
+
+/* Owner only; up to `max` messages in order, stopping at the first slot
+   that is not published yet and after an ipc_call() request, which has
+   to be answered before the next one is taken */
+uint32_t mailbox_pop_batch(mailbox_t *mb, message_t *out, uint32_t max)
+{
+    uint32_t n = 0;
+
+    while (n < max && mailbox_pop(mb, &out[n]) == 0)
+    {
+        if (out[n++].reply_cap)
+            break;
+    }
+    return n;
+}
+
+// --- Queries ---
+uint32_t mailbox_capacity(const mailbox_t *mb)
+{
+    return mb->mask + 1;
+}
+
+/* Claimed slots not yet read; a snapshot while senders are running */
+uint32_t mailbox_pending(const mailbox_t *mb)
+{
+    return mb->tail - mb->head;
+}
+
+/* A published message is waiting at the head; owner only */
+int mailbox_ready(const mailbox_t *mb)
+{
+    return mb->slots[mb->head & mb->mask].seq == mb->head + 1;
+}
+
+/* The next slot a sender would claim is not drained yet */
+int mailbox_full(const mailbox_t *mb)
+{
+    uint32_t pos = mb->tail;
+
+    return (int32_t)(mb->slots[pos & mb->mask].seq - pos) < 0;
+}
@@ -0,0 +1,50 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define MAILBOX_DEFAULT   8       /* slots when the creator asks for 0 */
+#define MAILBOX_MAX       256     /* larger requests are clamped */
+
+// --- IPC Message Structure ---
+typedef struct {
+    uint32_t sender_pid;
+    uint32_t value;
+    uint32_t reply_cap;     /* ipc_call() only: the caller's PCB, 0 otherwise */
+} message_t;
+
+// --- Mailbox ---
+/*
+ * Bounded multi-producer single-consumer ring. Senders on any CPU claim
+ * a slot by advancing `tail` with cmpxchg; only the owning process reads
+ * from `head`. Each slot's sequence number says whose turn it is, so no
+ * lock is ever taken on either side.
+ */
+typedef struct {
+    volatile uint32_t seq;
+    message_t msg;
+} mbox_slot_t;
+
+typedef struct {
+    mbox_slot_t *slots;
+    uint32_t mask;                  /* capacity - 1, a power of two */
+    volatile uint32_t tail;         /* next slot a sender claims */
+    uint32_t head;                  /* next slot the owner reads */
+} mailbox_t;
+
+// --- Mailbox API ---
+void mailbox_init(void);
+int  mailbox_setup(mailbox_t *mb, uint32_t size);
+void mailbox_release(mailbox_t *mb);
+int  mailbox_push(mailbox_t *mb, const message_t *msg);
+int  mailbox_pop(mailbox_t *mb, message_t *out);
+uint32_t mailbox_push_batch(mailbox_t *mb, uint32_t sender_pid,
+                            const uint32_t *values, uint32_t count);
+uint32_t mailbox_pop_batch(mailbox_t *mb, message_t *out, uint32_t max);
+uint32_t mailbox_capacity(const mailbox_t *mb);
+uint32_t mailbox_pending(const mailbox_t *mb);
+int  mailbox_ready(const mailbox_t *mb);
+int  mailbox_full(const mailbox_t *mb);
+
+#endif
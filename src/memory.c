@@ -1,232 +1,592 @@
-// --- Memory Management Implementation ---
-#include "memory.h"
-#include "serial.h"
-#include "string.h"
-
-// --- Memory Block Metadata ---
-typedef struct {
-    uint32_t size;
-    uint8_t is_allocated;
-    uint8_t is_stack;
-} mem_block_t;
-
-static uint8_t kernel_heap[KERNEL_HEAP_SIZE];
-
-#define MAX_ALLOCS 64
-static mem_block_t alloc_metadata[MAX_ALLOCS];
-static uint32_t alloc_count = 0;
-
-static uint32_t heap_offset = 0;
-static uint32_t stack_offset = KERNEL_HEAP_SIZE;
-
-// --- Memory Statistics ---
-typedef struct {
-    uint32_t total_allocated;
-    uint32_t total_freed;
-    uint32_t heap_allocations;
-    uint32_t stack_allocations;
-    uint32_t failed_allocations;
-} mem_stats_t;
-
-static mem_stats_t mem_stats = {0};
-
-// --- Initialization ---
-void memory_init(void)
-{
-    heap_offset = 0;
-    stack_offset = KERNEL_HEAP_SIZE;
-    alloc_count = 0;
-
-    for (int i = 0; i < MAX_ALLOCS; i++)
-    {
-        alloc_metadata[i].size = 0;
-        alloc_metadata[i].is_allocated = 0;
-        alloc_metadata[i].is_stack = 0;
-    }
-
-    mem_stats.total_allocated = 0;
-    mem_stats.total_freed = 0;
-    mem_stats.heap_allocations = 0;
-    mem_stats.stack_allocations = 0;
-    mem_stats.failed_allocations = 0;
-
-    serial_puts("[memory] initialized (heap=");
-    serial_put_num(KERNEL_HEAP_SIZE / 1024);
-    serial_puts("KB)\n");
-}
-
-// --- Helper Functions ---
-static uint32_t align4(uint32_t size)
-{
-    return (size + 3) & ~3;
-}
-
-static int find_metadata_slot(void)
-{
-    for (int i = 0; i < MAX_ALLOCS; i++)
-    {
-        if (!alloc_metadata[i].is_allocated)
-            return i;
-    }
-    return -1;
-}
-
-// --- Heap Allocation ---
-void* kmalloc(uint32_t size)
-{
-    if (size == 0)
-        return 0;
-
-    size = align4(size);
-
-    if (heap_offset + size >= stack_offset)
-    {
-        serial_puts("[memory] FAIL: heap exhausted (need ");
-        serial_put_num(size / 100);
-        serial_puts("B)\n");
-        mem_stats.failed_allocations++;
-        return 0;
-    }
-
-    int meta_idx = find_metadata_slot();
-    if (meta_idx < 0)
-    {
-        serial_puts("[memory] FAIL: metadata table full\n");
-        mem_stats.failed_allocations++;
-        return 0;
-    }
-
-    void *ptr = &kernel_heap[heap_offset];
-    
-    alloc_metadata[meta_idx].size = size;
-    alloc_metadata[meta_idx].is_allocated = 1;
-    alloc_metadata[meta_idx].is_stack = 0;
-    alloc_count++;
-
-    mem_stats.total_allocated += size;
-    mem_stats.heap_allocations++;
-
-    heap_offset += size;
-
-    serial_puts("[memory] kmalloc ");
-    serial_put_num(size / 100);
-    serial_puts("B at ");
-    serial_put_num((uint32_t)ptr / 10000);
-    serial_puts("\n");
-
-    return ptr;
-}
-
-// --- Heap Deallocation ---
-void kfree(void *ptr)
-{
-    if (!ptr)
-        return;
-
-    for (int i = 0; i < MAX_ALLOCS; i++)
-    {
-        if (alloc_metadata[i].is_allocated && !alloc_metadata[i].is_stack)
-        {
-            alloc_metadata[i].is_allocated = 0;
-            mem_stats.total_freed += alloc_metadata[i].size;
-
-            serial_puts("[memory] kfree ");
-            serial_put_num(alloc_metadata[i].size / 100);
-            serial_puts("B\n");
-            return;
-        }
-    }
-
-    serial_puts("[memory] WARNING: double free or invalid ptr\n");
-}
-
-// --- Stack Allocation ---
-void* alloc_stack(void)
-{
-    if (stack_offset < heap_offset + KERNEL_STACK_SIZE)
-    {
-        serial_puts("[memory] FAIL: stack exhausted\n");
-        mem_stats.failed_allocations++;
-        return 0;
-    }
-
-    int meta_idx = find_metadata_slot();
-    if (meta_idx < 0)
-    {
-        serial_puts("[memory] FAIL: metadata table full for stack\n");
-        return 0;
-    }
-
-    stack_offset -= KERNEL_STACK_SIZE;
-    void *ptr = &kernel_heap[stack_offset];
-
-    alloc_metadata[meta_idx].size = KERNEL_STACK_SIZE;
-    alloc_metadata[meta_idx].is_allocated = 1;
-    alloc_metadata[meta_idx].is_stack = 1;
-    alloc_count++;
-
-    mem_stats.total_allocated += KERNEL_STACK_SIZE;
-    mem_stats.stack_allocations++;
-
-    serial_puts("[memory] alloc_stack ");
-    serial_put_num(KERNEL_STACK_SIZE / 1000);
-    serial_puts("KB at ");
-    serial_put_num((uint32_t)ptr / 10000);
-    serial_puts("\n");
-
-    return ptr;
-}
-
-// --- Stack Deallocation ---
-void free_stack(void *stack)
-{
-    if (!stack)
-        return;
-
-    for (int i = 0; i < MAX_ALLOCS; i++)
-    {
-        if (alloc_metadata[i].is_allocated && alloc_metadata[i].is_stack)
-        {
-            alloc_metadata[i].is_allocated = 0;
-            mem_stats.total_freed += alloc_metadata[i].size;
-
-            serial_puts("[memory] free_stack ");
-            serial_put_num(alloc_metadata[i].size / 1000);
-            serial_puts("KB\n");
-            return;
-        }
-    }
-}
-
-// --- Statistics ---
-void memory_print_stats(void)
-{
-    serial_puts("\n========== MEMORY STATISTICS ==========\n");
-    serial_puts("Total allocated: ");
-    serial_put_num(mem_stats.total_allocated / 1000);
-    serial_puts("KB\n");
-
-    serial_puts("Total freed: ");
-    serial_put_num(mem_stats.total_freed / 1000);
-    serial_puts("KB\n");
-
-    serial_puts("Heap allocations: ");
-    serial_put_num(mem_stats.heap_allocations);
-    serial_puts("\n");
-
-    serial_puts("Stack allocations: ");
-    serial_put_num(mem_stats.stack_allocations);
-    serial_puts("\n");
-
-    serial_puts("Failed allocations: ");
-    serial_put_num(mem_stats.failed_allocations);
-    serial_puts("\n");
-
-    serial_puts("Heap used: ");
-    serial_put_num(heap_offset / 1000);
-    serial_puts("KB / ");
-    serial_put_num(KERNEL_HEAP_SIZE / 1000);
-    serial_puts("KB\n");
-
-    serial_puts("======================================\n\n");
-}
+// --- Memory Management Implementation ---
+#include "memory.h"
+#include "pmm.h"
+#include "serial.h"
+#include "log.h"
+#include "string.h"
+#include "spinlock.h"
+#include "trace.h"
+
+/*
+ * Heap memory is taken from the page frame allocator one page at a time
+ * and the frame's page_t descriptor records what it is used for, so
+ * kfree() can find the size class of any pointer in O(1) just from its
+ * address:
+ *
+ *   - small pages are carved into equal objects of one size class
+ *     (16B .. 2KB) whose free objects sit on a per-class free list
+ *   - large allocations (> 2KB) take a run of whole frames
+ *   - stacks come from a buddy allocator (see below)
+ */
+
+// --- Size Class Free Lists ---
+/* Free objects carry FREE_OBJ_MAGIC, so freeing one again is caught */
+#define FREE_OBJ_MAGIC  0xF7EEB10Cu
+
+typedef struct free_obj {
+    struct free_obj *next;
+    uint32_t magic;
+} free_obj_t;
+
+static free_obj_t *free_lists[NUM_SIZE_CLASSES];
+
+// --- Stack Buddy Free Lists ---
+typedef struct stack_block {
+    struct stack_block *next;
+    struct stack_block *prev;
+} stack_block_t;
+
+static stack_block_t *stack_free_lists[STACK_ORDERS];
+
+// --- Memory Statistics ---
+typedef struct {
+    uint32_t total_allocated;
+    uint32_t total_freed;
+    uint32_t heap_allocations;
+    uint32_t stack_allocations;
+    uint32_t failed_allocations;
+    uint32_t large_allocations;
+    uint32_t class_in_use[NUM_SIZE_CLASSES];
+    uint32_t class_free[NUM_SIZE_CLASSES];
+    uint32_t class_pages[NUM_SIZE_CLASSES];
+    uint32_t large_pages;
+    uint32_t stack_pages;
+    uint32_t stack_chunks;
+    uint32_t stack_free_blocks[STACK_ORDERS];
+} mem_stats_t;
+
+static mem_stats_t mem_stats = {0};
+static spinlock_t heap_lock = SPINLOCK_INIT;
+
+// --- Helper Functions ---
+static inline uint32_t class_size(uint32_t cls)
+{
+    return MIN_CLASS_SIZE << cls;
+}
+
+static uint32_t size_to_class(uint32_t size)
+{
+    uint32_t cls = 0;
+    while (class_size(cls) < size)
+        cls++;
+    return cls;
+}
+
+/* The magic is only a hint, as live data may happen to hold it; the
+   free list has the final say, and is walked only when the hint hits */
+static int on_free_list(uint32_t cls, const free_obj_t *obj)
+{
+    if (obj->magic != FREE_OBJ_MAGIC)
+        return 0;
+
+    for (const free_obj_t *o = free_lists[cls]; o; o = o->next)
+    {
+        if (o == obj)
+            return 1;
+    }
+    return 0;
+}
+
+/* Grab a fresh page and split it into objects of the given class */
+static int refill_class(uint32_t cls)
+{
+    uint8_t *base = pmm_alloc_page();
+    if (!base)
+        return -1;
+
+    page_t *page = pmm_page(base);
+    page->type = PAGE_TYPE_HEAP_SMALL;
+    page->order = cls;
+
+    uint32_t size = class_size(cls);
+
+    for (uint32_t off = 0; off + size <= PAGE_SIZE; off += size)
+    {
+        free_obj_t *obj = (free_obj_t*)(base + off);
+        obj->next = free_lists[cls];
+        obj->magic = FREE_OBJ_MAGIC;
+        free_lists[cls] = obj;
+        mem_stats.class_free[cls]++;
+    }
+
+    mem_stats.class_pages[cls]++;
+    return 0;
+}
+
+// --- Initialization ---
+void memory_init(void)
+{
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        free_lists[i] = 0;
+        mem_stats.class_in_use[i] = 0;
+        mem_stats.class_free[i] = 0;
+        mem_stats.class_pages[i] = 0;
+    }
+
+    mem_stats.total_allocated = 0;
+    mem_stats.total_freed = 0;
+    mem_stats.heap_allocations = 0;
+    mem_stats.stack_allocations = 0;
+    mem_stats.failed_allocations = 0;
+    mem_stats.large_allocations = 0;
+    mem_stats.large_pages = 0;
+    mem_stats.stack_pages = 0;
+    mem_stats.stack_chunks = 0;
+
+    for (int i = 0; i < STACK_ORDERS; i++)
+    {
+        stack_free_lists[i] = 0;
+        mem_stats.stack_free_blocks[i] = 0;
+    }
+
+    if (log_on(LOG_INFO, LOG_MEM))
+    {
+        serial_puts("[memory] initialized (heap=");
+        serial_put_num(pmm_free_frames() * (PAGE_SIZE / 1024));
+        serial_puts("KB available, ");
+        serial_put_num(NUM_SIZE_CLASSES);
+        serial_puts(" size classes)\n");
+    }
+}
+
+// --- Heap Allocation ---
+static void* kmalloc_locked(uint32_t size)
+{
+    if (size == 0)
+        return 0;
+
+    void *ptr;
+    uint32_t granted;
+
+    if (size <= MAX_CLASS_SIZE)
+    {
+        uint32_t cls = size_to_class(size);
+
+        if (!free_lists[cls] && refill_class(cls) < 0)
+        {
+            if (log_on(LOG_ERROR, LOG_MEM))
+            {
+                serial_puts("[memory] FAIL: heap exhausted (need ");
+                serial_put_num(size);
+                serial_puts("B)\n");
+            }
+            mem_stats.failed_allocations++;
+            return 0;
+        }
+
+        free_obj_t *obj = free_lists[cls];
+        free_lists[cls] = obj->next;
+        obj->magic = 0;
+
+        mem_stats.class_free[cls]--;
+        mem_stats.class_in_use[cls]++;
+
+        ptr = obj;
+        granted = class_size(cls);
+    }
+    else
+    {
+        /* The run length must fit in the head page's count for kfree() */
+        uint32_t pages = size > PMM_MAX_RUN_PAGES * PAGE_SIZE ? 0 :
+                         (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        void *first = pages ? pmm_alloc_pages(pages) : 0;
+
+        if (!first)
+        {
+            if (log_on(LOG_ERROR, LOG_MEM))
+            {
+                serial_puts("[memory] FAIL: heap exhausted (need ");
+                serial_put_num(size);
+                serial_puts("B)\n");
+            }
+            mem_stats.failed_allocations++;
+            return 0;
+        }
+
+        page_t *head = pmm_page(first);
+        head->type = PAGE_TYPE_HEAP_LARGE;
+        head->count = pages;
+
+        mem_stats.large_allocations++;
+        mem_stats.large_pages += pages;
+
+        ptr = first;
+        granted = pages * PAGE_SIZE;
+    }
+
+    mem_stats.total_allocated += granted;
+    mem_stats.heap_allocations++;
+
+    if (log_on(LOG_TRACE, LOG_MEM))
+    {
+        serial_puts("[memory] kmalloc ");
+        serial_put_num(granted);
+        serial_puts("B at ");
+        serial_put_num((uint32_t)ptr);
+        serial_puts("\n");
+    }
+
+    return ptr;
+}
+
+// --- Heap Deallocation ---
+static void kfree_locked(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    page_t *page = pmm_page(ptr);
+    uint32_t offset = (uint32_t)ptr & (PAGE_SIZE - 1);
+
+    if (!page)
+    {
+        klog(LOG_WARN, LOG_MEM, "[memory] WARNING: kfree of pointer outside heap\n");
+        return;
+    }
+
+    if (page->type == PAGE_TYPE_HEAP_SMALL)
+    {
+        uint32_t cls = page->order;
+        uint32_t size = class_size(cls);
+
+        if (offset % size != 0)
+        {
+            klog(LOG_WARN, LOG_MEM, "[memory] WARNING: kfree of misaligned pointer\n");
+            return;
+        }
+
+        free_obj_t *obj = (free_obj_t*)ptr;
+        if (on_free_list(cls, obj))
+        {
+            klog(LOG_WARN, LOG_MEM, "[memory] WARNING: double free or invalid ptr\n");
+            return;
+        }
+
+        obj->next = free_lists[cls];
+        obj->magic = FREE_OBJ_MAGIC;
+        free_lists[cls] = obj;
+
+        mem_stats.class_in_use[cls]--;
+        mem_stats.class_free[cls]++;
+        mem_stats.total_freed += size;
+
+        if (log_on(LOG_TRACE, LOG_MEM))
+        {
+            serial_puts("[memory] kfree ");
+            serial_put_num(size);
+            serial_puts("B\n");
+        }
+        return;
+    }
+
+    if (page->type == PAGE_TYPE_HEAP_LARGE && page->count && offset == 0)
+    {
+        uint32_t pages = page->count;
+
+        page->count = 0;
+        pmm_free_pages(ptr, pages);
+
+        mem_stats.large_pages -= pages;
+        mem_stats.total_freed += pages * PAGE_SIZE;
+
+        if (log_on(LOG_TRACE, LOG_MEM))
+        {
+            serial_puts("[memory] kfree ");
+            serial_put_num(pages * PAGE_SIZE);
+            serial_puts("B\n");
+        }
+        return;
+    }
+
+    klog(LOG_WARN, LOG_MEM, "[memory] WARNING: double free or invalid ptr\n");
+}
+
+// --- Stack Buddy Allocator ---
+/*
+ * Stacks are power-of-two blocks from 4KB (order 0) to 64KB (order 4).
+ * Top-level 64KB chunks are taken from the frame allocator aligned to
+ * their size, so the buddy of a block is simply `addr ^ size`. The head
+ * frame of every free block is tagged PAGE_TYPE_STACK_FREE with its
+ * order, which lets free_stack() check whether the buddy is free in O(1)
+ * and merge upwards. A chunk that coalesces back to 64KB is returned to
+ * the frame allocator.
+ */
+static inline uint32_t order_size(uint32_t order)
+{
+    return MIN_STACK_SIZE << order;
+}
+
+static void stack_list_push(uint32_t order, void *addr)
+{
+    stack_block_t *block = (stack_block_t*)addr;
+
+    block->prev = 0;
+    block->next = stack_free_lists[order];
+    if (block->next)
+        block->next->prev = block;
+    stack_free_lists[order] = block;
+
+    page_t *page = pmm_page(addr);
+    page->type = PAGE_TYPE_STACK_FREE;
+    page->order = order;
+    mem_stats.stack_free_blocks[order]++;
+}
+
+static void stack_list_remove(uint32_t order, void *addr)
+{
+    stack_block_t *block = (stack_block_t*)addr;
+
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        stack_free_lists[order] = block->next;
+    if (block->next)
+        block->next->prev = block->prev;
+
+    pmm_page(addr)->type = PAGE_TYPE_RESERVED;
+    mem_stats.stack_free_blocks[order]--;
+}
+
+static uint32_t stack_size_to_order(uint32_t size)
+{
+    uint32_t order = 0;
+    while (order_size(order) < size)
+        order++;
+    return order;
+}
+
+// --- Stack Allocation ---
+static void* alloc_stack_locked(uint32_t size)
+{
+    if (size == 0)
+        size = KERNEL_STACK_SIZE;
+
+    if (size > MAX_STACK_SIZE)
+    {
+        klog(LOG_ERROR, LOG_MEM, "[memory] FAIL: stack size too large\n");
+        mem_stats.failed_allocations++;
+        return 0;
+    }
+
+    uint32_t order = stack_size_to_order(size);
+    uint32_t found = order;
+
+    while (found < STACK_ORDERS && !stack_free_lists[found])
+        found++;
+
+    uint8_t *block;
+
+    if (found < STACK_ORDERS)
+    {
+        block = (uint8_t*)stack_free_lists[found];
+        stack_list_remove(found, block);
+    }
+    else
+    {
+        found = STACK_ORDERS - 1;
+        block = pmm_alloc_pages_aligned(MAX_STACK_SIZE / PAGE_SIZE,
+                                        MAX_STACK_SIZE / PAGE_SIZE);
+        if (!block)
+        {
+            klog(LOG_ERROR, LOG_MEM, "[memory] FAIL: stack exhausted\n");
+            mem_stats.failed_allocations++;
+            return 0;
+        }
+        mem_stats.stack_chunks++;
+    }
+
+    /* Split down to the requested order, keeping the lower half */
+    while (found > order)
+    {
+        found--;
+        stack_list_push(found, block + order_size(found));
+    }
+
+    page_t *page = pmm_page(block);
+    page->type = PAGE_TYPE_STACK;
+    page->order = order;
+    page->count = order_size(order) / PAGE_SIZE;
+
+    mem_stats.total_allocated += order_size(order);
+    mem_stats.stack_allocations++;
+    mem_stats.stack_pages += page->count;
+
+    if (log_on(LOG_TRACE, LOG_MEM))
+    {
+        serial_puts("[memory] alloc_stack ");
+        serial_put_num(order_size(order) / 1024);
+        serial_puts("KB at ");
+        serial_put_num((uint32_t)block);
+        serial_puts("\n");
+    }
+
+    return block;
+}
+
+// --- Stack Deallocation ---
+static void free_stack_locked(void *stack)
+{
+    if (!stack)
+        return;
+
+    page_t *page = pmm_page(stack);
+
+    if (!page || page->type != PAGE_TYPE_STACK || !page->count ||
+        ((uint32_t)stack & (PAGE_SIZE - 1)))
+    {
+        klog(LOG_WARN, LOG_MEM, "[memory] WARNING: free_stack of invalid stack\n");
+        return;
+    }
+
+    uint32_t order = page->order;
+    uint32_t size = order_size(order);
+
+    page->type = PAGE_TYPE_RESERVED;
+    page->count = 0;
+
+    mem_stats.stack_pages -= size / PAGE_SIZE;
+    mem_stats.total_freed += size;
+
+    /* Merge with free buddies as far up as possible */
+    uint32_t block = (uint32_t)stack;
+
+    while (order < STACK_ORDERS - 1)
+    {
+        uint32_t buddy = block ^ order_size(order);
+        page_t *bp = pmm_page((void*)buddy);
+
+        if (!bp || bp->type != PAGE_TYPE_STACK_FREE || bp->order != order)
+            break;
+
+        stack_list_remove(order, (void*)buddy);
+        if (buddy < block)
+            block = buddy;
+        order++;
+    }
+
+    if (order == STACK_ORDERS - 1)
+    {
+        pmm_free_pages((void*)block, MAX_STACK_SIZE / PAGE_SIZE);
+        mem_stats.stack_chunks--;
+    }
+    else
+    {
+        stack_list_push(order, (void*)block);
+    }
+
+    if (log_on(LOG_TRACE, LOG_MEM))
+    {
+        serial_puts("[memory] free_stack ");
+        serial_put_num(size / 1024);
+        serial_puts("KB\n");
+    }
+}
+
+// --- Public Entry Points ---
+/* Allocators are shared with interrupt context (the scheduler runs from
+   the timer IRQ) and with the other CPUs, so every entry point runs
+   under heap_lock with interrupts off. */
+void* kmalloc(uint32_t size)
+{
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = kmalloc_locked(size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    trace_event(TRACE_ALLOC, size, (uint32_t)ptr);
+    return ptr;
+}
+
+void kfree(void *ptr)
+{
+    trace_event(TRACE_FREE, (uint32_t)ptr, 0);
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    kfree_locked(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+void* alloc_stack(uint32_t size)
+{
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = alloc_stack_locked(size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    return ptr;
+}
+
+void free_stack(void *stack)
+{
+    uint32_t flags = spin_lock_irqsave(&heap_lock);
+    free_stack_locked(stack);
+    spin_unlock_irqrestore(&heap_lock, flags);
+}
+
+// --- Statistics ---
+void memory_print_stats(void)
+{
+    uint32_t pages_small = 0;
+
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+        pages_small += mem_stats.class_pages[i];
+
+    serial_puts("\n========== MEMORY STATISTICS ==========\n");
+    serial_puts("Total allocated: ");
+    serial_put_num(mem_stats.total_allocated / 1024);
+    serial_puts("KB\n");
+
+    serial_puts("Total freed: ");
+    serial_put_num(mem_stats.total_freed / 1024);
+    serial_puts("KB\n");
+
+    serial_puts("Heap allocations: ");
+    serial_put_num(mem_stats.heap_allocations);
+    serial_puts(" (large: ");
+    serial_put_num(mem_stats.large_allocations);
+    serial_puts(")\n");
+
+    serial_puts("Stack allocations: ");
+    serial_put_num(mem_stats.stack_allocations);
+    serial_puts("\n");
+
+    serial_puts("Failed allocations: ");
+    serial_put_num(mem_stats.failed_allocations);
+    serial_puts("\n");
+
+    serial_puts("Pages: ");
+    serial_put_num(pages_small);
+    serial_puts(" small, ");
+    serial_put_num(mem_stats.large_pages);
+    serial_puts(" large, ");
+    serial_put_num(mem_stats.stack_pages);
+    serial_puts(" stack\n");
+
+    serial_puts("Stack chunks: ");
+    serial_put_num(mem_stats.stack_chunks);
+    serial_puts(" x ");
+    serial_put_num(MAX_STACK_SIZE / 1024);
+    serial_puts("KB, free blocks:");
+    for (int i = 0; i < STACK_ORDERS; i++)
+    {
+        serial_puts(" ");
+        serial_put_num(order_size(i) / 1024);
+        serial_puts("K=");
+        serial_put_num(mem_stats.stack_free_blocks[i]);
+    }
+    serial_puts("\n");
+
+    pmm_print_stats();
+
+    serial_puts("\nSize class   in-use   free   pages\n");
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        serial_puts("  ");
+        serial_put_num(class_size(i));
+        serial_puts("B\t     ");
+        serial_put_num(mem_stats.class_in_use[i]);
+        serial_puts("\t     ");
+        serial_put_num(mem_stats.class_free[i]);
+        serial_puts("\t    ");
+        serial_put_num(mem_stats.class_pages[i]);
+        serial_puts("\n");
+    }
+
+    serial_puts("======================================\n\n");
+}
@@ -1,17 +1,26 @@
-#ifndef MEMORY_H
-#define MEMORY_H
-
-#include "types.h"
-
-#define KERNEL_HEAP_SIZE  (64 * 1024)
-#define KERNEL_STACK_SIZE 4096
-
-// --- Memory Manager API ---
-void memory_init(void);
-void* kmalloc(uint32_t size);
-void kfree(void *ptr);
-void* alloc_stack(void);
-void free_stack(void *stack);
-void memory_print_stats(void);
-
-#endif
\ No newline at end of file
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "types.h"
+
+#define KERNEL_STACK_SIZE 4096   /* default when no size is requested */
+
+// --- Stack Buddy Orders ---
+#define MIN_STACK_SIZE    4096
+#define MAX_STACK_SIZE    (64 * 1024)
+#define STACK_ORDERS      5        /* 4KB, 8KB, 16KB, 32KB, 64KB */
+
+// --- Heap Size Classes ---
+#define MIN_CLASS_SIZE    16
+#define MAX_CLASS_SIZE    2048
+#define NUM_SIZE_CLASSES  8     /* 16, 32, 64, ... 2048 */
+
+// --- Memory Manager API ---
+void memory_init(void);
+void* kmalloc(uint32_t size);
+void kfree(void *ptr);
+void* alloc_stack(uint32_t size);
+void free_stack(void *stack);
+void memory_print_stats(void);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MULTIBOOT_H
+#define MULTIBOOT_H
+
+#include "types.h"
+
+// --- Multiboot (v1) Definitions ---
+#define MULTIBOOT_BOOTLOADER_MAGIC  0x2BADB002
+
+#define MULTIBOOT_INFO_MEMORY       0x00000001  /* mem_lower / mem_upper valid */
+#define MULTIBOOT_INFO_MEM_MAP      0x00000040  /* mmap_addr / mmap_length valid */
+
+#define MULTIBOOT_MEMORY_AVAILABLE  1
+
+// --- Boot Information Structure (passed in EBX) ---
+typedef struct {
+    uint32_t flags;
+    uint32_t mem_lower;         /* KB below 1MB */
+    uint32_t mem_upper;         /* KB above 1MB */
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;
+    uint32_t mmap_addr;
+} __attribute__((packed)) multiboot_info_t;
+
+// --- Memory Map Entry ---
+typedef struct {
+    uint32_t size;              /* size of the rest of the entry */
+    uint64_t addr;
+    uint64_t len;
+    uint32_t type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+#endif
@@ -0,0 +1,613 @@
+// --- Paging Implementation ---
+#include "paging.h"
+#include "pmm.h"
+#include "idt.h"
+#include "gdt.h"
+#include "process.h"
+#include "memory.h"
+#include "context_switch.h"
+#include "cpu.h"
+#include "serial.h"
+#include "string.h"
+#include "smp.h"
+
+/*
+ * The kernel runs identity mapped: every physical frame the page frame
+ * allocator knows about is mapped at the same virtual address, so frame
+ * addresses from pmm can be used directly as pointers. Page 0 is left
+ * unmapped to catch NULL dereferences.
+ *
+ * Each process gets its own page directory whose kernel entries point at
+ * the same page tables as the kernel directory. Changing a kernel PTE
+ * (for example making a stack guard page non-present) therefore applies
+ * to every address space at once.
+ *
+ * When the CPU supports PSE the direct map uses 4MB pages, marked global
+ * when PGE is available so they survive CR3 reloads. A 4MB region is
+ * split into a 4KB page table only when something inside it needs page
+ * granularity (page 0, stack guard pages); since that rewrites a kernel
+ * PDE, every registered directory is updated along with it.
+ *
+ * Other CPUs may still cache the global 4MB translation of a region
+ * being split, which no CR3 reload drops, so a split (and switching the
+ * page size) is followed by a flush IPI to every CPU. The 4KB entries of
+ * split regions are never global: a guard page set later only has to be
+ * invlpg'd locally, since whichever CPU first runs the new process on
+ * that stack loads the process's CR3 and drops any stale entry then.
+ * Registered directories (spaces[]) and the direct map are changed
+ * under proc_lock.
+ */
+
+#define PDE_INDEX(v)  ((v) >> 22)
+#define PTE_INDEX(v)  (((v) >> 12) & 0x3FF)
+#define PDE_SPAN      (4u * 1024 * 1024)
+
+static uint32_t *kernel_dir;
+static uint32_t direct_map_end;
+
+// --- Direct Map State ---
+static uint32_t  dm_pdes;                    /* 4MB regions in the direct map */
+static uint32_t *dm_tables[DM_MAX_PDES];     /* 4KB table, once built */
+static uint8_t   dm_pinned[DM_MAX_PDES];     /* must stay split */
+
+static int cpu_has_pse;
+static int cpu_has_pge;
+static int large_pages;
+
+// --- Registered Address Spaces ---
+static uint32_t **spaces;
+static uint32_t space_count;
+static uint32_t space_capacity;
+
+static struct {
+    uint32_t page_tables;
+    uint32_t spaces;
+    uint32_t guards;
+    uint32_t splits;
+} paging_stats;
+
+// --- Helper Functions ---
+static inline void invlpg(uint32_t vaddr)
+{
+    __asm__ volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+}
+
+static inline int is_private(uint32_t vaddr)
+{
+    return vaddr >= PRIVATE_BASE && vaddr < PRIVATE_END;
+}
+
+static uint32_t* alloc_table(void)
+{
+    uint32_t *table = pmm_alloc_page();
+    if (!table)
+        return 0;
+
+    memset(table, 0, PAGE_SIZE);
+    paging_stats.page_tables++;
+    return table;
+}
+
+/* Page table covering vaddr, created on demand when `create` is set */
+static uint32_t* get_table(uint32_t *dir, uint32_t vaddr, int create)
+{
+    uint32_t pde = dir[PDE_INDEX(vaddr)];
+
+    if (pde & PDE_LARGE)
+        return 0;
+    if (pde & PTE_PRESENT)
+        return (uint32_t*)(pde & PTE_FRAME);
+    if (!create)
+        return 0;
+
+    uint32_t *table = alloc_table();
+    if (!table)
+        return 0;
+
+    dir[PDE_INDEX(vaddr)] = (uint32_t)table | PTE_PRESENT | PTE_WRITE;
+    return table;
+}
+
+/* Drop every cached translation on this CPU, including global ones */
+void paging_flush_tlb(void)
+{
+    uint32_t cr4 = read_cr4();
+
+    if (cr4 & CR4_PGE)
+    {
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    }
+    else
+    {
+        write_cr3(read_cr3());
+    }
+}
+
+/* Kernel PDEs are copied by value, so changes go to every directory */
+static void set_kernel_pde(uint32_t idx, uint32_t value)
+{
+    kernel_dir[idx] = value;
+    for (uint32_t i = 0; i < space_count; i++)
+        spaces[i][idx] = value;
+}
+
+static uint32_t* dm_table(uint32_t idx)
+{
+    if (dm_tables[idx])
+        return dm_tables[idx];
+
+    uint32_t *table = alloc_table();
+    if (!table)
+        panic("no memory for direct map page table");
+
+    for (uint32_t i = 0; i < 1024; i++)
+        table[i] = ((idx << 22) + (i << 12)) | PTE_PRESENT | PTE_WRITE;
+
+    if (idx == 0)
+        table[0] = 0;                   /* catch NULL pointer dereferences */
+
+    dm_tables[idx] = table;
+    return table;
+}
+
+static uint32_t dm_pde(uint32_t idx)
+{
+    if (large_pages && !dm_pinned[idx])
+    {
+        uint32_t global = cpu_has_pge ? PTE_GLOBAL : 0;
+        return (idx << 22) | PTE_PRESENT | PTE_WRITE | PDE_LARGE | global;
+    }
+    return (uint32_t)dm_table(idx) | PTE_PRESENT | PTE_WRITE;
+}
+
+/* Make sure vaddr is covered by a 4KB page table from now on */
+static void dm_split(uint32_t vaddr)
+{
+    uint32_t idx = PDE_INDEX(vaddr);
+
+    if (idx >= dm_pdes || dm_pinned[idx])
+        return;
+
+    dm_pinned[idx] = 1;
+    if (kernel_dir[idx] & PDE_LARGE)
+    {
+        set_kernel_pde(idx, dm_pde(idx));
+        paging_flush_tlb();
+        smp_flush_tlb_others();
+        paging_stats.splits++;
+    }
+}
+
+static void page_fault_handler(regs_t *regs)
+{
+    uint32_t cr2;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    serial_puts("\n[paging] PAGE FAULT at ");
+    serial_put_num(cr2);
+    serial_puts(" (EIP=");
+    serial_put_num(regs->eip);
+    serial_puts(regs->err_code & 0x1 ? ", protection" : ", not present");
+    serial_puts(regs->err_code & 0x2 ? ", write)\n" : ", read)\n");
+
+    paging_describe_fault(cr2);
+    panic("page fault");
+}
+
+// --- Initialization ---
+void paging_init(void)
+{
+    uint32_t a, b, c, d;
+    cpuid(1, &a, &b, &c, &d);
+    cpu_has_pse = (d & CPUID_EDX_PSE) != 0;
+    cpu_has_pge = (d & CPUID_EDX_PGE) != 0;
+    large_pages = cpu_has_pse;
+
+    kernel_dir = alloc_table();
+    if (!kernel_dir)
+        panic("no memory for kernel page directory");
+
+    direct_map_end = (pmm_memory_end() + PDE_SPAN - 1) & ~(PDE_SPAN - 1);
+    dm_pdes = direct_map_end / PDE_SPAN;
+
+    dm_pinned[0] = 1;                   /* page 0 stays unmapped */
+    for (uint32_t i = 0; i < dm_pdes; i++)
+        kernel_dir[i] = dm_pde(i);
+
+    /* Pre-create the MMIO table so later device mappings never add a
+       kernel PDE after process directories have copied them */
+    get_table(kernel_dir, MMIO_BASE, 1);
+
+    isr_register(VEC_PAGE_FAULT, page_fault_handler);
+    gdt_set_dfault_cr3((uint32_t)kernel_dir);
+
+    if (cpu_has_pse)
+        write_cr4(read_cr4() | CR4_PSE);
+
+    uint32_t cr0;
+    write_cr3((uint32_t)kernel_dir);
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= 0x80010000;                  /* PG | WP */
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0));
+
+    if (large_pages && cpu_has_pge)
+        write_cr4(read_cr4() | CR4_PGE);
+
+    serial_puts("[paging] enabled (direct map ");
+    serial_put_num(direct_map_end / (1024 * 1024));
+    serial_puts("MB, ");
+    serial_puts(large_pages ? "4MB" : "4KB");
+    serial_puts(cpu_has_pge && large_pages ? " global pages, " : " pages, ");
+    serial_put_num(paging_stats.page_tables);
+    serial_puts(" tables)\n");
+}
+
+/* Switch the direct map between 4MB global pages and plain 4KB pages;
+   called with proc_lock held */
+int paging_set_large_pages(int enable)
+{
+    if (enable && !cpu_has_pse)
+        return -1;
+
+    large_pages = enable;
+
+    for (uint32_t i = 0; i < dm_pdes; i++)
+        set_kernel_pde(i, dm_pde(i));
+
+    /* CR4.PGE stays as it is on every CPU: only 4MB entries are ever
+       global, and with large pages off there are none */
+    paging_flush_tlb();
+    smp_flush_tlb_others();
+
+    return 0;
+}
+
+int paging_large_pages_enabled(void)
+{
+    return large_pages;
+}
+
+uint32_t paging_kernel_dir(void)
+{
+    return (uint32_t)kernel_dir;
+}
+
+// --- Address Spaces ---
+uint32_t paging_create_space(void)
+{
+    uint32_t *dir = alloc_table();
+    if (!dir)
+        return 0;
+    paging_stats.page_tables--;
+
+    if (space_count == space_capacity)
+    {
+        uint32_t capacity = space_capacity ? space_capacity * 2 : 16;
+        uint32_t **list = kmalloc(capacity * sizeof(uint32_t*));
+        if (!list)
+        {
+            pmm_free_page(dir);
+            return 0;
+        }
+
+        for (uint32_t i = 0; i < space_count; i++)
+            list[i] = spaces[i];
+        kfree(spaces);
+        spaces = list;
+        space_capacity = capacity;
+    }
+    spaces[space_count++] = dir;
+
+    for (uint32_t i = 0; i < 1024; i++)
+    {
+        if (!is_private(i << 22))
+            dir[i] = kernel_dir[i];
+    }
+
+    paging_stats.spaces++;
+    return (uint32_t)dir;
+}
+
+/* Drop every private mapping so the directory can be handed to a new process */
+void paging_reset_space(uint32_t dir)
+{
+    uint32_t *pd = (uint32_t*)dir;
+
+    if (!pd || pd == kernel_dir)
+        return;
+
+    for (uint32_t i = PDE_INDEX(PRIVATE_BASE); i < PDE_INDEX(PRIVATE_END); i++)
+    {
+        if (pd[i] & PTE_PRESENT)
+        {
+            pmm_free_page((void*)(pd[i] & PTE_FRAME));
+            paging_stats.page_tables--;
+        }
+        pd[i] = 0;
+    }
+}
+
+/* Reset the directory, stop tracking it and free it */
+void paging_destroy_space(uint32_t dir)
+{
+    uint32_t *pd = (uint32_t*)dir;
+
+    if (!pd || pd == kernel_dir)
+        return;
+
+    paging_reset_space(dir);
+    for (uint32_t i = 0; i < space_count; i++)
+    {
+        if (spaces[i] == pd)
+        {
+            spaces[i] = spaces[--space_count];
+            break;
+        }
+    }
+    pmm_free_page(pd);
+    paging_stats.spaces--;
+}
+
+// --- Mapping ---
+int paging_map(uint32_t dir, uint32_t vaddr, uint32_t paddr, uint32_t flags)
+{
+    uint32_t *pd = (uint32_t*)dir;
+
+    /* Kernel tables are shared: only create new ones in the private window */
+    uint32_t *table = get_table(pd, vaddr, is_private(vaddr) && pd != kernel_dir);
+    if (!table)
+        return -1;
+
+    table[PTE_INDEX(vaddr)] = (paddr & PTE_FRAME) | (flags & 0xFFF) | PTE_PRESENT;
+    invlpg(vaddr);
+    return 0;
+}
+
+void paging_unmap(uint32_t dir, uint32_t vaddr)
+{
+    uint32_t *table = get_table((uint32_t*)dir, vaddr, 0);
+    if (!table)
+        return;
+
+    table[PTE_INDEX(vaddr)] = 0;
+    invlpg(vaddr);
+}
+
+uint32_t* paging_get_pte(uint32_t dir, uint32_t vaddr)
+{
+    uint32_t *table = get_table((uint32_t*)dir, vaddr, 0);
+    if (!table)
+        return 0;
+    return &table[PTE_INDEX(vaddr)];
+}
+
+int paging_is_mapped(uint32_t dir, uint32_t vaddr)
+{
+    uint32_t pde = ((uint32_t*)dir)[PDE_INDEX(vaddr)];
+    if ((pde & (PTE_PRESENT | PDE_LARGE)) == (PTE_PRESENT | PDE_LARGE))
+        return 1;
+
+    uint32_t *pte = paging_get_pte(dir, vaddr);
+    return pte && (*pte & PTE_PRESENT);
+}
+
+// --- Stack Guard Pages ---
+void paging_set_guard(void *page)
+{
+    dm_split((uint32_t)page);
+
+    uint32_t *pte = paging_get_pte((uint32_t)kernel_dir, (uint32_t)page);
+    if (!pte)
+        return;
+
+    *pte &= ~PTE_PRESENT;
+    invlpg((uint32_t)page);
+    paging_stats.guards++;
+}
+
+void paging_clear_guard(void *page)
+{
+    uint32_t *pte = paging_get_pte((uint32_t)kernel_dir, (uint32_t)page);
+    if (!pte)
+        return;
+
+    *pte |= PTE_PRESENT;
+    invlpg((uint32_t)page);
+    paging_stats.guards--;
+}
+
+// --- Statistics ---
+void paging_print_stats(void)
+{
+    serial_puts("Paging: direct map ");
+    serial_put_num(direct_map_end / (1024 * 1024));
+    serial_puts("MB with ");
+    serial_puts(large_pages ? "4MB" : "4KB");
+    serial_puts(" pages (");
+    serial_put_num(paging_stats.splits);
+    serial_puts(" split), ");
+    serial_put_num(paging_stats.page_tables);
+    serial_puts(" tables, ");
+    serial_put_num(paging_stats.spaces);
+    serial_puts(" spaces, ");
+    serial_put_num(paging_stats.guards);
+    serial_puts(" guard pages\n");
+}
+
+// --- Fault Reporting ---
+void paging_describe_fault(uint32_t addr)
+{
+    if (addr < PAGE_SIZE)
+    {
+        serial_puts("[paging] NULL pointer dereference\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < proc_table_size; i++)
+    {
+        pcb_t *p = proc_table[i];
+        uint32_t base;
+
+        if (!p || !p->stack_base)
+            continue;
+
+        base = (uint32_t)p->stack_base;
+        if (addr >= base - PAGE_SIZE && addr < base)
+        {
+            serial_puts("[paging] stack overflow: PID ");
+            serial_put_num(p->pid);
+            serial_puts(" ran into its guard page\n");
+            return;
+        }
+    }
+}
+
+// --- TLB Benchmark ---
+/*
+ * Ping-pongs between two contexts in different address spaces and
+ * touches a spread of kernel pages after every switch, the way the
+ * scheduler and IPC paths touch PCBs and queues. Every switch reloads
+ * CR3, so the cost difference between the two runs is the kernel TLB
+ * refill that 4MB global pages avoid.
+ */
+static uint32_t *bench_main_sp;
+static uint32_t *bench_peer_sp;
+static uint32_t bench_main_dir;
+static uint32_t bench_peer_dir;
+static uint32_t bench_touch[BENCH_TOUCH_PAGES];
+static uint32_t bench_touch_count;
+
+static void bench_touch_pages(void)
+{
+    for (uint32_t i = 0; i < bench_touch_count; i++)
+        (void)*(volatile uint32_t*)bench_touch[i];
+}
+
+static void bench_peer(void)
+{
+    for (;;)
+    {
+        bench_touch_pages();
+        context_switch_asm(&bench_peer_sp, &bench_main_sp, bench_main_dir);
+    }
+}
+
+/* Cycles per switch. Run in batches of BENCH_BATCH rounds, each on the
+   benchmark's own directory with proc_lock held, so that neither the
+   page size nor spaces[] changes under it; in between, the lock and
+   interrupts are let go. */
+static uint32_t bench_run(uint32_t rounds)
+{
+    uint64_t total = 0;
+
+    for (uint32_t done = 0; done < rounds; done += BENCH_BATCH)
+    {
+        uint32_t batch = rounds - done < BENCH_BATCH ? rounds - done : BENCH_BATCH;
+        uint32_t flags = spin_lock_irqsave(&proc_lock);
+        uint32_t saved_cr3 = read_cr3();
+
+        write_cr3(bench_main_dir);
+
+        /* warm up once so every batch starts from the same state */
+        context_switch_asm(&bench_main_sp, &bench_peer_sp, bench_peer_dir);
+
+        uint64_t start = rdtsc();
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            bench_touch_pages();
+            context_switch_asm(&bench_main_sp, &bench_peer_sp, bench_peer_dir);
+        }
+        total += rdtsc() - start;
+
+        write_cr3(saved_cr3);
+        spin_unlock_irqrestore(&proc_lock, flags);
+    }
+
+    return div64_32(total, rounds * 2);
+}
+
+void paging_benchmark(uint32_t rounds)
+{
+    static uint8_t *peer_stack;
+
+    if (rounds == 0)
+        rounds = 1000;
+    if (rounds > BENCH_MAX_ROUNDS)
+        rounds = BENCH_MAX_ROUNDS;
+
+    if (!bench_main_dir)
+    {
+        uint32_t flags = spin_lock_irqsave(&proc_lock);
+        bench_main_dir = paging_create_space();
+        bench_peer_dir = paging_create_space();
+        spin_unlock_irqrestore(&proc_lock, flags);
+        peer_stack = alloc_stack(KERNEL_STACK_SIZE);
+        if (!bench_main_dir || !bench_peer_dir || !peer_stack)
+        {
+            serial_puts("[paging] benchmark: out of memory\n");
+            return;
+        }
+
+        /* Pages spread across RAM, skipping anything unmapped */
+        uint32_t stride = (direct_map_end - 0x100000) / BENCH_TOUCH_PAGES;
+        for (uint32_t i = 0; i < BENCH_TOUCH_PAGES; i++)
+        {
+            uint32_t addr = (0x100000 + i * stride) & PTE_FRAME;
+            if (addr < pmm_memory_end() && paging_is_mapped((uint32_t)kernel_dir, addr))
+                bench_touch[bench_touch_count++] = addr;
+        }
+    }
+
+    /* Fresh initial frame for the peer (see context_switch_asm) */
+    uint32_t *sp = (uint32_t*)(peer_stack + KERNEL_STACK_SIZE);
+    *(--sp) = 0;
+    *(--sp) = (uint32_t)bench_peer;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0x002;
+    bench_peer_sp = sp;
+
+    /* The mode switch rewrites every registered directory, so it must
+       not race with process creation */
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    int saved_mode = large_pages;
+    paging_set_large_pages(0);
+    spin_unlock_irqrestore(&proc_lock, flags);
+
+    uint32_t small_cost = bench_run(rounds);
+
+    uint32_t large_cost = 0;
+    flags = spin_lock_irqsave(&proc_lock);
+    int large = paging_set_large_pages(1) == 0;
+    spin_unlock_irqrestore(&proc_lock, flags);
+    if (large)
+        large_cost = bench_run(rounds);
+
+    flags = spin_lock_irqsave(&proc_lock);
+    paging_set_large_pages(saved_mode);
+    spin_unlock_irqrestore(&proc_lock, flags);
+
+    serial_puts("\n========== CONTEXT SWITCH BENCHMARK ==========\n");
+    serial_puts("Rounds: ");
+    serial_put_num(rounds);
+    serial_puts(", pages touched per switch: ");
+    serial_put_num(bench_touch_count);
+    serial_puts("\n");
+    serial_puts("4KB pages:            ");
+    serial_put_num(small_cost);
+    serial_puts(" cycles/switch\n");
+    serial_puts("4MB global pages:     ");
+    if (cpu_has_pse)
+    {
+        serial_put_num(large_cost);
+        serial_puts(" cycles/switch\n");
+    }
+    else
+    {
+        serial_puts("n/a (no PSE)\n");
+    }
+    serial_puts("==============================================\n\n");
+}
@@ -0,0 +1,58 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "types.h"
+
+// --- Page Table Entry Flags ---
+#define PTE_PRESENT   0x001
+#define PTE_WRITE     0x002
+#define PTE_USER      0x004
+#define PTE_PCD       0x010     /* cache disable, for MMIO */
+#define PDE_LARGE     0x080     /* 4MB page (needs CR4.PSE) */
+#define PTE_GLOBAL    0x100     /* survives CR3 reloads (needs CR4.PGE) */
+#define PTE_FRAME     0xFFFFF000
+
+// --- Address Space Layout ---
+/*
+ * Everything outside the private window is kernel space: the identity
+ * (direct) map of physical memory and the MMIO window. Those page
+ * directory entries are created once in paging_init() and shared by
+ * every address space. The private window belongs to one address space.
+ */
+#define PRIVATE_BASE  0x80000000
+#define PRIVATE_END   0xC0000000
+#define MMIO_BASE     0xFEC00000  /* IOAPIC / local APIC registers */
+
+#define DM_MAX_PDES       256       /* direct map covers at most 1GB */
+#define BENCH_TOUCH_PAGES 32
+#define BENCH_MAX_ROUNDS  1000000
+#define BENCH_BATCH       1000      /* rounds per proc_lock hold */
+
+// --- Paging API ---
+void paging_init(void);
+uint32_t paging_kernel_dir(void);
+int  paging_set_large_pages(int enable);
+int  paging_large_pages_enabled(void);
+void paging_flush_tlb(void);
+
+uint32_t paging_create_space(void);
+void paging_reset_space(uint32_t dir);
+void paging_destroy_space(uint32_t dir);
+
+int  paging_map(uint32_t dir, uint32_t vaddr, uint32_t paddr, uint32_t flags);
+void paging_unmap(uint32_t dir, uint32_t vaddr);
+uint32_t* paging_get_pte(uint32_t dir, uint32_t vaddr);
+int  paging_is_mapped(uint32_t dir, uint32_t vaddr);
+
+// --- Stack Guard Pages ---
+void paging_set_guard(void *page);
+void paging_clear_guard(void *page);
+
+// --- Benchmark and Statistics ---
+void paging_benchmark(uint32_t rounds);
+void paging_print_stats(void);
+
+// --- Fault Reporting ---
+void paging_describe_fault(uint32_t addr);
+
+#endif
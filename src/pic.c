@@ -0,0 +1,82 @@
+// --- 8259 Programmable Interrupt Controller ---
+#include "pic.h"
+#include "io.h"
+#include "serial.h"
+
+/*
+ * The BIOS leaves IRQ0-7 on vectors 8-15, on top of the CPU exceptions.
+ * We move both PICs to vectors 32-47 and start with every line masked;
+ * drivers unmask the IRQs they handle.
+ */
+
+static inline void io_wait(void)
+{
+    outb(0x80, 0);
+}
+
+// --- Initialization ---
+void pic_init(void)
+{
+    outb(PIC1_CMD, 0x11);               /* ICW1: init, expect ICW4 */
+    io_wait();
+    outb(PIC2_CMD, 0x11);
+    io_wait();
+    outb(PIC1_DATA, IRQ_BASE);          /* ICW2: vector offsets */
+    io_wait();
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    io_wait();
+    outb(PIC1_DATA, 0x04);              /* ICW3: slave on IRQ2 */
+    io_wait();
+    outb(PIC2_DATA, 0x02);
+    io_wait();
+    outb(PIC1_DATA, 0x01);              /* ICW4: 8086 mode */
+    io_wait();
+    outb(PIC2_DATA, 0x01);
+    io_wait();
+
+    outb(PIC1_DATA, 0xFB);              /* all masked except cascade */
+    outb(PIC2_DATA, 0xFF);
+
+    serial_puts("[pic] remapped IRQ0-15 to vectors ");
+    serial_put_num(IRQ_BASE);
+    serial_puts("-");
+    serial_put_num(IRQ_BASE + NUM_IRQS - 1);
+    serial_puts("\n");
+}
+
+// --- IRQ Control ---
+void pic_send_eoi(uint8_t irq)
+{
+    if (irq >= 8)
+        outb(PIC2_CMD, 0x20);
+    outb(PIC1_CMD, 0x20);
+}
+
+void pic_unmask(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq % 8)));
+}
+
+void pic_mask(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq % 8)));
+}
+
+/* IRQ7/IRQ15 can fire without a matching in-service bit */
+int pic_is_spurious(uint8_t irq)
+{
+    if (irq != 7 && irq != 15)
+        return 0;
+
+    uint16_t cmd = irq == 7 ? PIC1_CMD : PIC2_CMD;
+    outb(cmd, 0x0B);                    /* OCW3: read ISR */
+    if (inb(cmd) & 0x80)
+        return 0;
+
+    /* A spurious IRQ15 still needs an EOI on the master */
+    if (irq == 15)
+        outb(PIC1_CMD, 0x20);
+    return 1;
+}
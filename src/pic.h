@@ -0,0 +1,25 @@
+#ifndef PIC_H
+#define PIC_H
+
+#include "types.h"
+
+// --- 8259 PIC Configuration ---
+#define PIC1_CMD      0x20
+#define PIC1_DATA     0x21
+#define PIC2_CMD      0xA0
+#define PIC2_DATA     0xA1
+
+#define IRQ_BASE      32        /* IRQ0 is remapped to vector 32 */
+#define NUM_IRQS      16
+
+#define IRQ_TIMER     0
+#define IRQ_COM1      4
+
+// --- PIC API ---
+void pic_init(void);
+void pic_send_eoi(uint8_t irq);
+void pic_unmask(uint8_t irq);
+void pic_mask(uint8_t irq);
+int  pic_is_spurious(uint8_t irq);
+
+#endif
@@ -0,0 +1,174 @@
+// --- 8253/8254 Programmable Interval Timer ---
+#include "pit.h"
+#include "pic.h"
+#include "idt.h"
+#include "io.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "cpu.h"
+
+#define PIT_CHANNEL0  0x40
+#define PIT_CMD       0x43
+
+#define PIT_MODE_ONESHOT   0x30         /* channel 0, lo/hi byte, mode 0 */
+#define PIT_MODE_PERIODIC  0x34         /* channel 0, lo/hi byte, mode 2 */
+#define PIT_LATCH          0x00         /* latch channel 0 count */
+
+#define TSC_CALIBRATE_US   10000
+
+static uint32_t tick_divisor;           /* PIT clocks per tick */
+static uint32_t oneshot_ticks;          /* 0 while periodic */
+static uint32_t oneshot_count;          /* PIT clocks programmed for it */
+static volatile int oneshot_fired;
+
+uint32_t tsc_khz;
+
+static void pit_program(uint8_t mode, uint32_t count)
+{
+    /* The reload register is 16 bits; 0 counts as 65536 */
+    outb(PIT_CMD, mode);
+    outb(PIT_CHANNEL0, count & 0xFF);
+    outb(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+static void timer_irq(regs_t *regs)
+{
+    (void)regs;
+
+    /* In one-shot mode the idle loop accounts the elapsed ticks */
+    if (oneshot_ticks)
+    {
+        oneshot_fired = 1;
+        return;
+    }
+    scheduler_tick();
+}
+
+// --- Initialization ---
+void pit_init(uint32_t hz)
+{
+    tick_divisor = hz ? PIT_BASE_HZ / hz : 0;
+    if (tick_divisor == 0 || tick_divisor > 0x10000)
+        tick_divisor = 0x10000;
+
+    pit_program(PIT_MODE_PERIODIC, tick_divisor);
+
+    /* Before the tick is unmasked, so the interrupt cannot stretch it */
+    uint32_t flags = irq_save();
+    uint64_t start = rdtsc();
+    pit_delay_us(TSC_CALIBRATE_US);
+    uint64_t end = rdtsc();
+    irq_restore(flags);
+    tsc_khz = (uint32_t)(end - start) / (TSC_CALIBRATE_US / 1000);
+
+    isr_register(IRQ_BASE + IRQ_TIMER, timer_irq);
+    pic_unmask(IRQ_TIMER);
+
+    serial_puts("[pit] timer at ");
+    serial_put_num(hz);
+    serial_puts("Hz, TSC at ");
+    serial_put_num(tsc_khz / 1000);
+    serial_puts("MHz\n");
+}
+
+// --- Busy Wait ---
+/*
+ * Spin for at least `us` microseconds by watching channel 0 count down.
+ * Works with interrupts off, before the scheduler has anything to run
+ * (SMP bring-up, APIC timer calibration). Must not overlap pit_oneshot().
+ */
+static uint32_t pit_read_count(void)
+{
+    outb(PIT_CMD, PIT_LATCH);
+    uint32_t count = inb(PIT_CHANNEL0);
+    return count | (inb(PIT_CHANNEL0) << 8);
+}
+
+void pit_delay_us(uint32_t us)
+{
+    uint32_t target = us * (PIT_BASE_HZ / 1000) / 1000;    /* us < 3.5s */
+    uint32_t elapsed = 0;
+    uint32_t last = pit_read_count();
+
+    while (elapsed < target)
+    {
+        uint32_t now = pit_read_count();
+
+        /* Mode 2 counts down to 1 and reloads with tick_divisor */
+        elapsed += now <= last ? last - now : last + tick_divisor - now;
+        last = now;
+    }
+}
+
+// --- TSC Calibration ---
+/* Microseconds in `cycles`, saturating after about 71 minutes */
+uint32_t tsc_to_us(uint64_t cycles)
+{
+    uint32_t mhz = tsc_khz / 1000;
+
+    if (mhz == 0)
+        return 0;
+    return div64_32(cycles, mhz);
+}
+
+// --- One-Shot Mode ---
+/*
+ * Stop the periodic tick and interrupt once after `ticks` ticks instead.
+ * The 16-bit counter limits how far ahead that can be; the number of
+ * ticks actually programmed is returned. Call with interrupts disabled.
+ *
+ * Tick boundaries are kept across the switch both ways: the part of the
+ * current tick already counted down is taken off the one-shot count, and
+ * the part of a tick left over when it is stopped shortens the first
+ * periodic tick after it. Idling thus never stretches the tick.
+ */
+uint32_t pit_oneshot(uint32_t ticks)
+{
+    uint32_t max = 0xFFFF / tick_divisor;
+
+    if (max == 0 || ticks == 0)
+        return 0;
+    if (ticks > max)
+        ticks = max;
+
+    /* Mode 2 counts down from tick_divisor to 1 in every tick */
+    uint32_t now = pit_read_count();
+    uint32_t done = now && now <= tick_divisor ? tick_divisor - now : 0;
+
+    oneshot_ticks = ticks;
+    oneshot_count = ticks * tick_divisor - done;
+    oneshot_fired = 0;
+    pit_program(PIT_MODE_ONESHOT, oneshot_count);
+    return ticks;
+}
+
+/* Back to periodic mode; returns the whole ticks that elapsed */
+uint32_t pit_oneshot_stop(void)
+{
+    uint32_t clocks = oneshot_ticks * tick_divisor;
+
+    if (!oneshot_ticks)
+        return 0;
+
+    if (!oneshot_fired)
+    {
+        uint32_t remaining = pit_read_count();
+
+        /* After terminal count the counter wraps past `oneshot_count` */
+        if (remaining <= oneshot_count)
+            clocks -= remaining;
+    }
+
+    uint32_t elapsed = clocks / tick_divisor;
+    uint32_t partial = clocks % tick_divisor;
+
+    oneshot_ticks = 0;
+    pit_program(PIT_MODE_PERIODIC, tick_divisor - partial);
+    if (partial)
+    {
+        /* Loaded at the next reload, once the shortened tick is over */
+        outb(PIT_CHANNEL0, tick_divisor & 0xFF);
+        outb(PIT_CHANNEL0, (tick_divisor >> 8) & 0xFF);
+    }
+    return elapsed;
+}
@@ -0,0 +1,28 @@
+#ifndef PIT_H
+#define PIT_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define PIT_BASE_HZ   1193182
+#ifndef TIMER_HZ
+#define TIMER_HZ      1000      /* set with make TIMER_HZ=... */
+#endif
+
+#define MS_TO_TICKS(ms)  (((ms) * TIMER_HZ + 999) / 1000)
+
+// --- PIT API ---
+void pit_init(uint32_t hz);
+
+// --- Busy Wait ---
+void pit_delay_us(uint32_t us);
+
+// --- TSC Calibration ---
+extern uint32_t tsc_khz;        /* TSC cycles per ms, measured by pit_init() */
+uint32_t tsc_to_us(uint64_t cycles);
+
+// --- One-Shot Mode (tickless idle) ---
+uint32_t pit_oneshot(uint32_t ticks);
+uint32_t pit_oneshot_stop(void);
+
+#endif
@@ -0,0 +1,404 @@
+// --- Physical Page Frame Allocator ---
+#include "pmm.h"
+#include "serial.h"
+#include "log.h"
+#include "spinlock.h"
+
+/*
+ * Every physical frame has one bit in `frame_bitmap` (1 = in use) and one
+ * page_t descriptor in `frame_info`. Both arrays are placed right after
+ * the kernel image (__kernel_end from link.ld) and sized from the
+ * Multiboot memory map, so the amount of managed memory follows whatever
+ * the machine was booted with. Frames below the end of that metadata
+ * (low memory, the kernel itself) are never handed out.
+ *
+ * The loader may leave the Multiboot info and memory map right after the
+ * kernel image, where the metadata goes, so the map is copied into
+ * `mmap_regions` before any metadata is written.
+ */
+
+#define PMM_MAX_REGIONS 32
+
+extern uint8_t __kernel_end[];
+
+static uint32_t *frame_bitmap;
+static page_t   *frame_info;
+static uint32_t  frame_count;       /* frames covered by the bitmap */
+static uint32_t  usable_frames;     /* frames that were ever free */
+static uint32_t  free_frames;
+static uint32_t  search_hint;       /* lowest frame that might be free */
+static uint32_t  first_free_frame;
+
+/* Memory map entries, clipped to PMM_MAX_MEMORY */
+static struct {
+    uint32_t start;
+    uint32_t end;
+    int      available;
+} mmap_regions[PMM_MAX_REGIONS];
+static uint32_t mmap_region_count;
+static uint32_t mmap_dropped;
+
+static spinlock_t pmm_lock = SPINLOCK_INIT;
+
+// --- Helper Functions ---
+static inline uint32_t align_up(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline int frame_used(uint32_t frame)
+{
+    return frame_bitmap[frame / 32] & (1u << (frame % 32));
+}
+
+static inline void frame_set(uint32_t frame)
+{
+    frame_bitmap[frame / 32] |= (1u << (frame % 32));
+}
+
+static inline void frame_clear(uint32_t frame)
+{
+    frame_bitmap[frame / 32] &= ~(1u << (frame % 32));
+}
+
+/* Clip a 64-bit map region to the range the allocator manages */
+static int clip_region(uint64_t addr, uint64_t len, uint32_t *start, uint32_t *end)
+{
+    uint64_t region_end = addr + len;
+
+    if (addr >= PMM_MAX_MEMORY)
+        return 0;
+    if (region_end > PMM_MAX_MEMORY)
+        region_end = PMM_MAX_MEMORY;
+
+    *start = (uint32_t)addr;
+    *end = (uint32_t)region_end;
+    return *end > *start;
+}
+
+static uint32_t detect_memory_end(uint32_t magic, multiboot_info_t *mbi)
+{
+    if (magic != MULTIBOOT_BOOTLOADER_MAGIC || !mbi)
+        return PMM_DEFAULT_MEM;
+
+    if (mbi->flags & MULTIBOOT_INFO_MEM_MAP)
+    {
+        uint32_t top = 0;
+        uint32_t addr = mbi->mmap_addr;
+
+        while (addr < mbi->mmap_addr + mbi->mmap_length)
+        {
+            multiboot_mmap_entry_t *e = (multiboot_mmap_entry_t*)addr;
+            int available = e->type == MULTIBOOT_MEMORY_AVAILABLE;
+            uint32_t start, end;
+
+            addr += e->size + sizeof(e->size);
+            if (!clip_region(e->addr, e->len, &start, &end))
+                continue;
+
+            if (mmap_region_count == PMM_MAX_REGIONS)
+            {
+                mmap_dropped++;
+                continue;
+            }
+            mmap_regions[mmap_region_count].start = start;
+            mmap_regions[mmap_region_count].end = end;
+            mmap_regions[mmap_region_count].available = available;
+            mmap_region_count++;
+
+            if (available && end > top)
+                top = end;
+        }
+
+        if (top)
+            return top;
+    }
+
+    if (mbi->flags & MULTIBOOT_INFO_MEMORY)
+        return 1024 * 1024 + mbi->mem_upper * 1024;
+
+    return PMM_DEFAULT_MEM;
+}
+
+/* Mark [start, end) free (available) or used (anything else) */
+static void mark_region(uint32_t start, uint32_t end, int available)
+{
+    uint32_t first = available ? align_up(start, PAGE_SIZE) >> PAGE_SHIFT
+                               : start >> PAGE_SHIFT;
+    uint32_t last = available ? end >> PAGE_SHIFT
+                              : align_up(end, PAGE_SIZE) >> PAGE_SHIFT;
+
+    if (first < first_free_frame)
+        first = first_free_frame;
+    if (last > frame_count)
+        last = frame_count;
+
+    for (uint32_t f = first; f < last; f++)
+    {
+        if (available && frame_used(f))
+        {
+            frame_clear(f);
+            frame_info[f].type = PAGE_TYPE_FREE;
+            free_frames++;
+        }
+        else if (!available && !frame_used(f))
+        {
+            frame_set(f);
+            frame_info[f].type = PAGE_TYPE_RESERVED;
+            free_frames--;
+        }
+    }
+}
+
+// --- Initialization ---
+void pmm_init(uint32_t magic, multiboot_info_t *mbi)
+{
+    uint32_t mem_end = detect_memory_end(magic, mbi);
+
+    frame_count = mem_end >> PAGE_SHIFT;
+
+    uint32_t bitmap_words = (frame_count + 31) / 32;
+    uint32_t meta = (uint32_t)__kernel_end;
+
+    frame_bitmap = (uint32_t*)meta;
+    meta += bitmap_words * sizeof(uint32_t);
+    meta = align_up(meta, sizeof(page_t));
+    frame_info = (page_t*)meta;
+    meta += frame_count * sizeof(page_t);
+
+    first_free_frame = align_up(meta, PAGE_SIZE) >> PAGE_SHIFT;
+
+    for (uint32_t i = 0; i < bitmap_words; i++)
+        frame_bitmap[i] = 0xFFFFFFFF;
+
+    for (uint32_t f = 0; f < frame_count; f++)
+    {
+        frame_info[f].type = PAGE_TYPE_RESERVED;
+        frame_info[f].order = 0;
+        frame_info[f].count = 0;
+    }
+
+    free_frames = 0;
+
+    if (mmap_region_count)
+    {
+        /* Free available regions first, then re-reserve anything that
+           an overlapping entry says is not RAM. */
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (uint32_t i = 0; i < mmap_region_count; i++)
+            {
+                if (mmap_regions[i].available == (pass == 0))
+                    mark_region(mmap_regions[i].start, mmap_regions[i].end,
+                                mmap_regions[i].available);
+            }
+        }
+    }
+    else
+    {
+        mark_region(0, mem_end, 1);
+    }
+
+    usable_frames = free_frames;
+    search_hint = first_free_frame;
+
+    if (log_on(LOG_INFO, LOG_MEM))
+    {
+        serial_puts("[pmm] initialized (");
+        serial_put_num(mem_end / (1024 * 1024));
+        serial_puts("MB detected, ");
+        serial_put_num(free_frames);
+        serial_puts(" free frames from ");
+        serial_put_num(first_free_frame << PAGE_SHIFT);
+        serial_puts(")\n");
+    }
+
+    if (mmap_dropped)
+        klog(LOG_WARN, LOG_MEM, "[pmm] memory map too long, ignored extra entries\n");
+}
+
+// --- Allocation ---
+static void* alloc_pages_locked(uint32_t count)
+{
+    if (count == 0 || count > free_frames)
+        return 0;
+
+    uint32_t run = 0;
+    uint32_t f = search_hint;
+
+    while (f < frame_count)
+    {
+        /* Skip whole words of used frames while not inside a run */
+        if (run == 0 && (f % 32) == 0 && frame_bitmap[f / 32] == 0xFFFFFFFF)
+        {
+            f += 32;
+            continue;
+        }
+
+        if (frame_used(f))
+        {
+            run = 0;
+        }
+        else if (++run == count)
+        {
+            uint32_t first = f - count + 1;
+
+            for (uint32_t i = first; i <= f; i++)
+            {
+                frame_set(i);
+                frame_info[i].type = PAGE_TYPE_RESERVED;
+                frame_info[i].order = 0;
+                frame_info[i].count = 0;
+            }
+
+            free_frames -= count;
+            if (first == search_hint)
+                search_hint = f + 1;
+
+            return (void*)(first << PAGE_SHIFT);
+        }
+        f++;
+    }
+
+    return 0;
+}
+
+/* Contiguous run whose first frame is a multiple of `align` frames */
+static void* alloc_pages_aligned_locked(uint32_t count, uint32_t align)
+{
+    if (count == 0 || count > free_frames || (align & (align - 1)))
+        return 0;
+
+    uint32_t f = align_up(search_hint, align);
+
+    while (f + count <= frame_count)
+    {
+        uint32_t i;
+
+        for (i = 0; i < count; i++)
+        {
+            if (frame_used(f + i))
+                break;
+        }
+
+        if (i == count)
+        {
+            for (i = f; i < f + count; i++)
+            {
+                frame_set(i);
+                frame_info[i].type = PAGE_TYPE_RESERVED;
+                frame_info[i].order = 0;
+                frame_info[i].count = 0;
+            }
+
+            free_frames -= count;
+            if (f == search_hint)
+                search_hint = f + count;
+
+            return (void*)(f << PAGE_SHIFT);
+        }
+
+        f = align_up(f + i + 1, align);
+    }
+
+    return 0;
+}
+
+void* pmm_alloc_pages(uint32_t count)
+{
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    void *addr = alloc_pages_locked(count);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return addr;
+}
+
+void* pmm_alloc_pages_aligned(uint32_t count, uint32_t align)
+{
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    void *addr = alloc_pages_aligned_locked(count, align);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return addr;
+}
+
+void* pmm_alloc_page(void)
+{
+    return pmm_alloc_pages(1);
+}
+
+// --- Deallocation ---
+static void free_pages_locked(void *addr, uint32_t count)
+{
+    uint32_t first = (uint32_t)addr >> PAGE_SHIFT;
+
+    if ((uint32_t)addr & (PAGE_SIZE - 1) || first < first_free_frame ||
+        first + count > frame_count)
+    {
+        klog(LOG_WARN, LOG_MEM, "[pmm] WARNING: free of invalid frame\n");
+        return;
+    }
+
+    for (uint32_t f = first; f < first + count; f++)
+    {
+        if (!frame_used(f))
+        {
+            klog(LOG_WARN, LOG_MEM, "[pmm] WARNING: double free of frame\n");
+            continue;
+        }
+
+        frame_clear(f);
+        frame_info[f].type = PAGE_TYPE_FREE;
+        free_frames++;
+    }
+
+    if (first < search_hint)
+        search_hint = first;
+}
+
+void pmm_free_pages(void *addr, uint32_t count)
+{
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    free_pages_locked(addr, count);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+void pmm_free_page(void *addr)
+{
+    pmm_free_pages(addr, 1);
+}
+
+// --- Frame Lookup ---
+page_t* pmm_page(void *addr)
+{
+    uint32_t frame = (uint32_t)addr >> PAGE_SHIFT;
+
+    if (frame < first_free_frame || frame >= frame_count)
+        return 0;
+    return &frame_info[frame];
+}
+
+// --- Statistics ---
+uint32_t pmm_memory_end(void)
+{
+    return frame_count << PAGE_SHIFT;
+}
+
+uint32_t pmm_total_frames(void)
+{
+    return usable_frames;
+}
+
+uint32_t pmm_free_frames(void)
+{
+    return free_frames;
+}
+
+void pmm_print_stats(void)
+{
+    serial_puts("Physical frames: ");
+    serial_put_num(usable_frames - free_frames);
+    serial_puts(" used / ");
+    serial_put_num(usable_frames);
+    serial_puts(" (");
+    serial_put_num(free_frames * (PAGE_SIZE / 1024));
+    serial_puts("KB free)\n");
+}
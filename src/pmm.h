@@ -0,0 +1,53 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "types.h"
+#include "multiboot.h"
+
+// --- Configuration ---
+#define PAGE_SIZE        4096
+#define PAGE_SHIFT       12
+#define PMM_MAX_MEMORY   (1024u * 1024 * 1024)   /* manage at most 1GB */
+#define PMM_DEFAULT_MEM  (16u * 1024 * 1024)     /* if the loader tells us nothing */
+
+// --- Page Frame Descriptor ---
+/*
+ * One descriptor per physical frame. `type` says who owns the frame;
+ * `order` and `count` are interpreted by that owner (size class, run
+ * length, ...). This is what lets allocators map a pointer back to its
+ * bookkeeping without a search.
+ */
+typedef enum {
+    PAGE_TYPE_FREE = 0,
+    PAGE_TYPE_RESERVED,
+    PAGE_TYPE_HEAP_SMALL,
+    PAGE_TYPE_HEAP_LARGE,
+    PAGE_TYPE_STACK,
+    PAGE_TYPE_STACK_FREE,
+    PAGE_TYPE_SLAB,
+    PAGE_TYPE_GRANT
+} page_type_t;
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  order;
+    uint16_t count;
+} page_t;
+
+#define PMM_MAX_RUN_PAGES 0xFFFF    /* longest run page_t.count records */
+
+// --- Page Frame Allocator API ---
+void  pmm_init(uint32_t magic, multiboot_info_t *mbi);
+void* pmm_alloc_page(void);
+void* pmm_alloc_pages(uint32_t count);
+void* pmm_alloc_pages_aligned(uint32_t count, uint32_t align);
+void  pmm_free_page(void *addr);
+void  pmm_free_pages(void *addr, uint32_t count);
+page_t* pmm_page(void *addr);
+
+uint32_t pmm_memory_end(void);
+uint32_t pmm_total_frames(void);
+uint32_t pmm_free_frames(void);
+void pmm_print_stats(void);
+
+#endif
@@ -1,237 +1,1254 @@
-// --- Process Management Implementation ---
-#include "process.h"
-#include "memory.h"
-#include "serial.h"
-
-pcb_t proc_table[MAX_PROCESSES];
-pcb_t *current_proc = 0;
-
-static uint32_t next_pid = 1;
-static uint32_t process_count = 0;
-
-// --- Utility Functions ---
-static int find_free_slot(void) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (proc_table[i].state == PROC_UNUSED)
-            return i;
-    }
-    return -1;
-}
-
-static uint32_t* init_stack(void *stack_top, void (*entry)(void)) {
-    uint32_t *sp = (uint32_t*)stack_top;
-
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = 0;
-    *(--sp) = (uint32_t)entry;
-
-    return sp;
-}
-
-// --- Initialization ---
-void process_init(void) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        proc_table[i].state = PROC_UNUSED;
-        proc_table[i].pid = 0;
-        proc_table[i].msg_count = 0;
-        proc_table[i].priority = 10;
-        proc_table[i].age = 0;
-    }
-
-    process_count = 0;
-    serial_puts("[process] initialized (max=");
-    serial_put_num(MAX_PROCESSES);
-    serial_puts(" processes)\n");
-}
-
-// --- Process Creation and Termination ---
-int process_create(void (*entry)(void), uint32_t priority) {
-    int slot = find_free_slot();
-    if (slot < 0) {
-        serial_puts("[process] FAIL: process table full\n");
-        return -1;
-    }
-
-    void *stack = alloc_stack();
-    if (!stack) {
-        serial_puts("[process] FAIL: no memory for stack\n");
-        return -1;
-    }
-
-    pcb_t *p = &proc_table[slot];
-
-    p->pid = next_pid++;
-    p->state = PROC_READY;
-    p->priority = priority < 1 ? 1 : (priority > 20 ? 20 : priority);
-    p->age = 0;
-
-    p->stack_base = (uint32_t*)stack;
-    p->stack_ptr  = init_stack(stack, entry);
-
-    p->msg_count = 0;
-
-    process_count++;
-
-    serial_puts("[process] created PID ");
-    serial_put_num(p->pid);
-    serial_puts(" (priority=");
-    serial_put_num(p->priority);
-    serial_puts(")\n");
-
-    return p->pid;
-}
-
-void process_exit(void) {
-    if (!current_proc) {
-        serial_puts("[process] ERROR: no current process\n");
-        return;
-    }
-
-    serial_puts("[process] exit PID ");
-    serial_put_num(current_proc->pid);
-    serial_puts(" (state=TERMINATED)\n");
-
-    current_proc->state = PROC_TERMINATED;
-    free_stack(current_proc->stack_base);
-
-    if (process_count > 0)
-        process_count--;
-}
-
-// --- State Management ---
-void process_set_state(int pid, proc_state_t state) {
-    pcb_t *p = process_get(pid);
-    if (!p) {
-        serial_puts("[process] ERROR: invalid PID\n");
-        return;
-    }
-
-    p->state = state;
-
-    serial_puts("[process] PID ");
-    serial_put_num(pid);
-    serial_puts(" state changed\n");
-}
-
-proc_state_t process_get_state(int pid) {
-    pcb_t *p = process_get(pid);
-    if (!p)
-        return PROC_UNUSED;
-    return p->state;
-}
-
-// --- Process Utilities ---
-pcb_t* process_get(int pid) {
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (proc_table[i].pid == (uint32_t)pid)
-            return &proc_table[i];
-    }
-    return 0;
-}
-
-int process_current_pid(void) {
-    if (!current_proc)
-        return -1;
-    return current_proc->pid;
-}
-
-uint32_t process_count_active(void) {
-    uint32_t count = 0;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (proc_table[i].state != PROC_UNUSED)
-            count++;
-    }
-    return count;
-}
-
-void process_list(void) {
-    serial_puts("\n========== PROCESS TABLE ==========\n");
-    
-    uint32_t count = 0;
-    for (int i = 0; i < MAX_PROCESSES; i++) {
-        if (proc_table[i].state != PROC_UNUSED) {
-            count++;
-            serial_puts("PID ");
-            serial_put_num(proc_table[i].pid);
-            serial_puts(": state=");
-            
-            switch (proc_table[i].state) {
-                case PROC_READY:      serial_puts("READY"); break;
-                case PROC_RUNNING:    serial_puts("RUNNING"); break;
-                case PROC_BLOCKED:    serial_puts("BLOCKED"); break;
-                case PROC_SLEEPING:   serial_puts("SLEEPING"); break;
-                case PROC_TERMINATED: serial_puts("TERMINATED"); break;
-                default:              serial_puts("UNKNOWN");
-            }
-            serial_puts(", priority=");
-            serial_put_num(proc_table[i].priority);
-            serial_puts("\n");
-        }
-    }
-    
-    serial_puts("Total processes: ");
-    serial_put_num(count);
-    serial_puts("\n");
-    serial_puts("===================================\n\n");
-}
-
-// --- Inter-Process Communication ---
-int process_send(int dest_pid, uint32_t value) {
-    if (!current_proc) {
-        serial_puts("[IPC] ERROR: no current process\n");
-        return -1;
-    }
-
-    pcb_t *dest = process_get(dest_pid);
-    if (!dest || dest->state == PROC_UNUSED) {
-        serial_puts("[IPC] ERROR: invalid destination PID\n");
-        return -1;
-    }
-
-    if (dest->msg_count >= MAX_MESSAGES) {
-        serial_puts("[IPC] ERROR: message queue full\n");
-        return -1;
-    }
-
-    dest->msg_queue[dest->msg_count].sender_pid = current_proc->pid;
-    dest->msg_queue[dest->msg_count].value = value;
-    dest->msg_count++;
-
-    serial_puts("[IPC] message sent from PID ");
-    serial_put_num(current_proc->pid);
-    serial_puts(" to PID ");
-    serial_put_num(dest_pid);
-    serial_puts("\n");
-
-    return 0;
-}
-
-int process_receive(uint32_t *out_value) {
-    if (!current_proc) {
-        serial_puts("[IPC] ERROR: no current process\n");
-        return -1;
-    }
-
-    if (current_proc->msg_count == 0) {
-        serial_puts("[IPC] no message available\n");
-        return -1;
-    }
-
-    *out_value = current_proc->msg_queue[0].value;
-
-    for (uint32_t i = 1; i < current_proc->msg_count; i++)
-        current_proc->msg_queue[i - 1] = current_proc->msg_queue[i];
-
-    current_proc->msg_count--;
-
-    serial_puts("[IPC] received message value=");
-    serial_put_num(*out_value);
-    serial_puts("\n");
-
-    return 0;
-}
+// --- Process Management Implementation ---
+#include "process.h"
+#include "memory.h"
+#include "pmm.h"
+#include "paging.h"
+#include "slab.h"
+#include "string.h"
+#include "serial.h"
+#include "log.h"
+#include "scheduler.h"
+#include "smp.h"
+#include "cpu.h"
+#include "grant.h"
+#include "trace.h"
+#include "pit.h"
+
+pcb_t **proc_table = 0;
+uint32_t proc_table_size = 0;
+
+/* Process table and creation; taken before any run queue lock. IPC only
+   takes it to look up and pin the destination. */
+spinlock_t proc_lock = SPINLOCK_INIT;
+
+static uint32_t next_pid = 1;
+static uint32_t process_count = 0;
+static uint32_t free_hint = 0;          /* no free slot below this one */
+
+/* TERMINATED processes not reclaimed yet, linked by dead_next */
+static pcb_t *dead_list = 0;
+
+static kmem_cache_t *pcb_cache;
+
+// --- Stack Cache ---
+/* LIFO of zeroed default-size stacks kept off the allocator hot path,
+   under proc_lock */
+static void *stack_cache[STACK_CACHE_SIZE];
+static uint32_t stack_cache_count = 0;
+
+static struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t recycled;
+    uint32_t overflows;
+} stack_cache_stats;
+
+/* Usable size of a stack of at least `size` bytes: the request plus its
+   guard page is rounded up to a stack allocator block of at least two
+   pages, and the guard page comes out of that block. An 8KB request thus
+   takes a 16KB block and gets 12KB. Returns 0 when the request and its
+   guard page do not fit in MAX_STACK_SIZE. */
+static uint32_t stack_usable_size(uint32_t size) {
+    uint32_t block = 2 * PAGE_SIZE;
+
+    if (size > MAX_STACK_SIZE - PAGE_SIZE)
+        return 0;
+    while (block < size + PAGE_SIZE)
+        block <<= 1;
+    return block - PAGE_SIZE;
+}
+
+/* Every process stack sits on top of an unmapped guard page in the same
+   stack allocator block, so `size` is one page short of a block size
+   (see stack_usable_size()). */
+static void* guarded_stack_alloc(uint32_t size) {
+    uint8_t *block = alloc_stack(size + PAGE_SIZE);
+    if (!block)
+        return 0;
+
+    paging_set_guard(block);
+    return block + PAGE_SIZE;
+}
+
+static void guarded_stack_free(void *stack) {
+    uint8_t *block = (uint8_t*)stack - PAGE_SIZE;
+
+    paging_clear_guard(block);
+    free_stack(block);
+}
+
+static void* stack_get(uint32_t size) {
+    if (size == KERNEL_STACK_SIZE && stack_cache_count > 0) {
+        stack_cache_stats.hits++;
+        return stack_cache[--stack_cache_count];
+    }
+
+    stack_cache_stats.misses++;
+    return guarded_stack_alloc(size);
+}
+
+/* Zeroing happens here, when process_reap() reclaims the PCB, so
+   creation only ever pops a stack that is ready to use */
+static void stack_put(void *stack, uint32_t size) {
+    if (!stack)
+        return;
+
+    if (size == KERNEL_STACK_SIZE && stack_cache_count < STACK_CACHE_SIZE) {
+        memset(stack, 0, size);
+        stack_cache[stack_cache_count++] = stack;
+        stack_cache_stats.recycled++;
+        return;
+    }
+
+    if (size == KERNEL_STACK_SIZE)
+        stack_cache_stats.overflows++;
+    guarded_stack_free(stack);
+}
+
+// --- Sleep Timer ---
+/* Timer callback; every sleeper due on the same tick is woken in one
+   pass over its wheel slot */
+static void sleep_expired(void *arg) {
+    pcb_t *p = (pcb_t*)arg;
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+
+    if (p->state == PROC_SLEEPING) {
+        p->state = PROC_READY;
+        scheduler_enqueue(p);
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+}
+
+// --- IPC Wakeups ---
+/* Make a process BLOCKED in IPC runnable again. The caller has claimed
+   the wakeup by moving ipc_wait back to IPC_WAIT_NONE. */
+static void ipc_wake(pcb_t *p) {
+    p->state = PROC_READY;
+    scheduler_enqueue(p);
+}
+
+/* Timer callback: a blocked send ran out of time. The sender sees that
+   its deadline passed when it retries. */
+static void send_timeout(void *arg) {
+    pcb_t *p = (pcb_t*)arg;
+
+    if (cmpxchg(&p->ipc_wait, IPC_WAIT_SEND, IPC_WAIT_NONE) == IPC_WAIT_SEND)
+        ipc_wake(p);
+}
+
+/*
+ * A request's reply_cap pins its caller, so a caller killed while the
+ * request is queued or served stays a valid PCB to write the reply to.
+ * Whoever takes the caller out of IPC_WAIT_REPLY hands the pin back to
+ * it and ipc_call() drops it; a server that finds the caller gone drops
+ * it itself.
+ */
+static void put_reply_cap(pcb_t *caller) {
+    atomic_dec(&caller->senders);
+}
+
+/* An ipc_call() that will never get its reply returns -1 */
+static void fail_call(pcb_t *caller) {
+    if (cmpxchg(&caller->ipc_wait, IPC_WAIT_REPLY, IPC_WAIT_NONE) == IPC_WAIT_REPLY)
+        ipc_wake(caller);
+    else
+        put_reply_cap(caller);
+}
+
+/* Callers of an exiting server: the one being served and those still
+   queued in its mailbox */
+static void fail_callers(pcb_t *self) {
+    message_t msg;
+
+    if (self->reply_to)
+        fail_call(self->reply_to);
+    self->reply_to = 0;
+
+    memory_barrier();
+    while (mailbox_pop(&self->mailbox, &msg) == 0) {
+        if (msg.reply_cap)
+            fail_call((pcb_t*)msg.reply_cap);
+    }
+}
+
+static void unlink_sender(pcb_t *dest, pcb_t *p) {
+    pcb_t **link = &dest->send_waiters;
+
+    while (*link && *link != p)
+        link = &(*link)->ipc_next;
+    if (*link)
+        *link = p->ipc_next;
+    p->ipc_next = 0;
+}
+
+/* Called by the owner after it drained a slot: let one blocked sender
+   retry, skipping any whose timeout got there first. An exiting owner
+   wakes them all so they can fail. */
+static void wake_senders(pcb_t *self, int all) {
+    memory_barrier();
+    while (self->send_waiters) {
+        uint32_t flags = spin_lock_irqsave(&self->ipc_lock);
+        pcb_t *w = self->send_waiters;
+        if (w)
+            unlink_sender(self, w);
+        spin_unlock_irqrestore(&self->ipc_lock, flags);
+
+        if (w && cmpxchg(&w->ipc_wait, IPC_WAIT_SEND, IPC_WAIT_NONE) == IPC_WAIT_SEND) {
+            ipc_wake(w);
+            if (!all)
+                return;
+        }
+    }
+}
+
+/* A BLOCKED process is being moved on by process_set_state(); drop the
+   IPC wait it is in. The receiver a sender waits on is found through
+   the table, the sender keeps no pointer to it. Returns -1 if a wakeup
+   was already claimed by someone else, who will make it READY. */
+static int ipc_abort(pcb_t *p) {
+    uint32_t wait = p->ipc_wait;
+
+    if (wait == IPC_WAIT_NONE)
+        return 0;
+    if (cmpxchg(&p->ipc_wait, wait, IPC_WAIT_NONE) != wait)
+        return -1;
+
+    timer_cancel(&p->ipc_timer);
+    for (uint32_t i = 0; wait == IPC_WAIT_SEND && i < proc_table_size; i++) {
+        pcb_t *dest = proc_table[i];
+        if (!dest)
+            continue;
+        spin_lock(&dest->ipc_lock);
+        unlink_sender(dest, p);
+        spin_unlock(&dest->ipc_lock);
+    }
+    return 0;
+}
+
+// --- Slab Constructors ---
+/* PCBs come back to the cache with their mailbox and page directory
+   still attached, so a recycled PCB only builds them on its very first
+   use (or, for the mailbox, when it is created with another size).
+   pcb_dtor() lets go of them when the slab itself is freed. */
+static void pcb_ctor(void *obj) {
+    pcb_t *p = (pcb_t*)obj;
+
+    p->pid = 0;
+    p->state = PROC_UNUSED;
+    memset(&p->mailbox, 0, sizeof(p->mailbox));
+    p->senders = 0;
+    p->ipc_wait = IPC_WAIT_NONE;
+    spin_init(&p->ipc_lock);
+    p->send_waiters = 0;
+    p->ipc_next = 0;
+    p->page_dir = 0;
+    memset(p->grants, 0, sizeof(p->grants));
+    p->on_rq = 0;
+    p->on_cpu = 0;
+    timer_setup(&p->sleep_timer, sleep_expired, p);
+    timer_setup(&p->ipc_timer, send_timeout, p);
+}
+
+/* The slab is going back to the page frame allocator: so is what its
+   PCBs kept attached. Called with proc_lock held, from release_pcb(). */
+static void pcb_dtor(void *obj) {
+    pcb_t *p = (pcb_t*)obj;
+
+    mailbox_release(&p->mailbox);
+    paging_destroy_space(p->page_dir);
+    p->page_dir = 0;
+}
+
+// --- Utility Functions ---
+/* PCB of `pid`; proc_lock held, so it cannot be reclaimed meanwhile */
+static pcb_t* find_locked(int pid) {
+    for (uint32_t i = 0; i < proc_table_size; i++) {
+        if (proc_table[i] && proc_table[i]->pid == (uint32_t)pid)
+            return proc_table[i];
+    }
+    return 0;
+}
+
+static void release_pcb(pcb_t *p) {
+    message_t msg;
+
+    /* Requests that came in after its exit drained the mailbox */
+    while (mailbox_pop(&p->mailbox, &msg) == 0) {
+        if (msg.reply_cap)
+            put_reply_cap((pcb_t*)msg.reply_cap);
+    }
+
+    stack_put(p->stack_base, p->stack_size);
+    p->stack_base = 0;
+    grant_release_all(p);
+    paging_reset_space(p->page_dir);
+
+    proc_table[p->slot] = 0;
+    if (p->slot < free_hint)
+        free_hint = p->slot;
+    p->pid = 0;
+    p->state = PROC_UNUSED;
+    kmem_cache_free(pcb_cache, p);
+}
+
+static int grow_table(void) {
+    uint32_t new_size = proc_table_size * 2;
+    pcb_t **table = kmalloc(new_size * sizeof(pcb_t*));
+    if (!table)
+        return -1;
+
+    for (uint32_t i = 0; i < new_size; i++)
+        table[i] = i < proc_table_size ? proc_table[i] : 0;
+
+    kfree(proc_table);
+    proc_table = table;
+    proc_table_size = new_size;
+
+    if (log_on(LOG_INFO, LOG_PROC)) {
+        serial_puts("[process] table grown to ");
+        serial_put_num(new_size);
+        serial_puts(" slots\n");
+    }
+    return 0;
+}
+
+/* A TERMINATED PCB is only reclaimed once no CPU is still on its stack
+   and no sender is still writing into its mailbox; the rest stay on
+   the list for the next pass */
+static void reap_locked(void) {
+    pcb_t **link = &dead_list;
+
+    while (*link) {
+        pcb_t *p = *link;
+
+        if (p->on_cpu || p->senders) {
+            link = &p->dead_next;
+            continue;
+        }
+        *link = p->dead_next;
+        release_pcb(p);
+    }
+}
+
+static void mark_dead_locked(pcb_t *p) {
+    p->state = PROC_TERMINATED;
+    p->dead_next = dead_list;
+    dead_list = p;
+}
+
+/*
+ * Take `p` out for good, whether it exits or is killed. Called with
+ * proc_lock held; it is dropped, restoring `flags`, before senders
+ * blocked on the mailbox are woken to fail and so are callers whose
+ * requests will never be answered. `p` is pinned meanwhile so that
+ * process_reap() cannot free it under us.
+ */
+static void terminate_unlock(pcb_t *p, uint32_t flags) {
+    mark_dead_locked(p);
+    if (process_count > 0)
+        process_count--;
+
+    /* Killed halfway through a send or call */
+    if (p->pinned) {
+        atomic_dec(&p->pinned->senders);
+        p->pinned = 0;
+    }
+    atomic_inc(&p->senders);
+    spin_unlock_irqrestore(&proc_lock, flags);
+
+    wake_senders(p, 1);
+    fail_callers(p);
+    atomic_dec(&p->senders);
+}
+
+/* Reclaims exited processes: their stacks are zeroed and cached, their
+   grants and address spaces released and their slots freed. Idle CPUs
+   call this, so process_create() finds the work already done. */
+void process_reap(void) {
+    if (!dead_list)
+        return;
+
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    reap_locked();
+    spin_unlock_irqrestore(&proc_lock, flags);
+}
+
+/* Free slot at or above the hint; grows the table if full. Dead PCBs
+   are normally reaped by idle CPUs, so only a full table reaps here.
+   The hint only moves past the slot once create_locked() fills it. */
+static int find_free_slot(void) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = free_hint; i < proc_table_size; i++) {
+            if (!proc_table[i]) {
+                free_hint = i;
+                return i;
+            }
+        }
+        free_hint = proc_table_size;
+        if (pass == 0 && dead_list)
+            reap_locked();
+    }
+
+    uint32_t old_size = proc_table_size;
+    if (grow_table() < 0)
+        return -1;
+    return old_size;
+}
+
+/* First code a new process runs. The switch that got us here may have
+   come from the timer IRQ, so interrupts are still off, and it has not
+   been finished yet (see scheduler_context_switch). */
+static void process_trampoline(void) {
+    scheduler_finish_switch();
+    irq_enable();
+    current_proc->entry();
+    process_exit();
+}
+
+/* Build the frame context_switch_asm pops on the first switch in */
+static uint32_t* init_stack(void *stack_top) {
+    uint32_t *sp = (uint32_t*)stack_top;
+
+    *(--sp) = 0;                        /* padding */
+    *(--sp) = 0;                        /* trampoline never returns */
+    *(--sp) = (uint32_t)process_trampoline; /* context_switch_asm returns here */
+    *(--sp) = 0;                        /* ebp */
+    *(--sp) = 0;                        /* ebx */
+    *(--sp) = 0;                        /* esi */
+    *(--sp) = 0;                        /* edi */
+    *(--sp) = 0x002;                    /* eflags */
+
+    return sp;
+}
+
+// --- Initialization ---
+void process_init(void) {
+    pcb_cache = kmem_cache_create("pcb", sizeof(pcb_t), pcb_ctor, pcb_dtor);
+    mailbox_init();
+    grant_init();
+
+    proc_table_size = PROC_TABLE_INITIAL;
+    proc_table = kmalloc(proc_table_size * sizeof(pcb_t*));
+    for (uint32_t i = 0; i < proc_table_size; i++)
+        proc_table[i] = 0;
+
+    process_count = 0;
+    free_hint = 0;
+    dead_list = 0;
+    if (log_on(LOG_INFO, LOG_PROC)) {
+        serial_puts("[process] initialized (table=");
+        serial_put_num(proc_table_size);
+        serial_puts(" slots, grows on demand)\n");
+    }
+}
+
+// --- Process Creation and Termination ---
+static int create_locked(void (*entry)(void), uint32_t priority, uint32_t stack_size,
+                         uint32_t mailbox_size, proc_state_t state) {
+    int slot = find_free_slot();
+    if (slot < 0) {
+        klog(LOG_ERROR, LOG_PROC, "[process] FAIL: process table full\n");
+        return -1;
+    }
+
+    if (stack_size == 0)
+        stack_size = KERNEL_STACK_SIZE;
+    stack_size = stack_usable_size(stack_size);
+    if (!stack_size) {
+        klog(LOG_ERROR, LOG_PROC, "[process] FAIL: stack size exceeds limit\n");
+        return -1;
+    }
+
+    pcb_t *p = kmem_cache_alloc(pcb_cache);
+    if (!p) {
+        klog(LOG_ERROR, LOG_PROC, "[process] FAIL: no memory for PCB\n");
+        return -1;
+    }
+
+    if (!p->page_dir)
+        p->page_dir = paging_create_space();
+
+    void *stack = stack_get(stack_size);
+    if (!stack || !p->page_dir || mailbox_setup(&p->mailbox, mailbox_size) < 0) {
+        klog(LOG_ERROR, LOG_PROC, "[process] FAIL: no memory for stack or mailbox\n");
+        stack_put(stack, stack_size);
+        kmem_cache_free(pcb_cache, p);
+        return -1;
+    }
+
+    proc_table[slot] = p;
+    free_hint = slot + 1;
+
+    p->slot = slot;
+    p->pid = next_pid++;
+    p->state = state;
+    p->base_priority = priority < 1 ? 1 : (priority > MAX_PRIORITY ? MAX_PRIORITY : priority);
+    p->priority = p->base_priority;
+    p->age = 0;
+
+    p->stack_base = (uint32_t*)stack;
+    p->stack_size = stack_size;
+    p->stack_ptr  = init_stack((uint8_t*)stack + stack_size);
+    p->entry = entry;
+    p->ipc_wait = IPC_WAIT_NONE;
+    p->send_waiters = 0;
+    p->ipc_next = 0;
+    p->reply_to = 0;
+    p->ipc_replied = 0;
+    p->donated_priority = 0;
+    p->runtime = 0;
+    p->run_ticks = 0;
+    p->wait_time = 0;
+    p->run_start = 0;
+    p->ready_since = 0;
+    p->nr_switches = 0;
+
+    scheduler_admit(p);
+    process_count++;
+    trace_event(TRACE_CREATE, p->pid, p->priority);
+
+    if (log_on(LOG_INFO, LOG_PROC)) {
+        serial_puts("[process] created PID ");
+        serial_put_num(p->pid);
+        serial_puts(" (priority=");
+        serial_put_num(p->priority);
+        serial_puts(", stack=");
+        serial_put_num(stack_size / 1024);
+        serial_puts("KB, mailbox=");
+        serial_put_num(mailbox_capacity(&p->mailbox));
+        serial_puts(")\n");
+    }
+
+    return p->pid;
+}
+
+/* The stack gets at least `stack_size` bytes (KERNEL_STACK_SIZE if 0) and
+   at most MAX_STACK_SIZE - PAGE_SIZE, the rest of its block being the
+   guard page; larger requests fail. */
+int process_create(void (*entry)(void), uint32_t priority, uint32_t stack_size,
+                   uint32_t mailbox_size) {
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    int pid = create_locked(entry, priority, stack_size, mailbox_size, PROC_READY);
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return pid;
+}
+
+/* Like process_create(), but it only runs once made READY with
+   process_set_state() */
+int process_create_blocked(void (*entry)(void), uint32_t priority, uint32_t stack_size,
+                           uint32_t mailbox_size) {
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    int pid = create_locked(entry, priority, stack_size, mailbox_size, PROC_BLOCKED);
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return pid;
+}
+
+void process_exit(void) {
+    if (!current_proc) {
+        klog(LOG_ERROR, LOG_PROC, "[process] ERROR: no current process\n");
+        return;
+    }
+
+    irq_save();
+    trace_event(TRACE_EXIT, 0, 0);
+
+    if (log_on(LOG_INFO, LOG_PROC)) {
+        serial_puts("[process] exit PID ");
+        serial_put_num(current_proc->pid);
+        serial_puts(" (state=TERMINATED)\n");
+    }
+
+    /* The stack is still in use until we switch away; it goes back to
+       the stack cache when the PCB is reclaimed. Interrupts stay off. */
+    terminate_unlock(current_proc, spin_lock_irqsave(&proc_lock));
+
+    scheduler_context_switch();
+
+    /* A TERMINATED process is never picked again */
+    for (;;)
+        __asm__ volatile("hlt");
+}
+
+/* Block the calling process for `ticks` timer ticks; 0 just yields */
+void process_sleep(uint32_t ticks) {
+    if (!current_proc) {
+        klog(LOG_ERROR, LOG_PROC, "[process] ERROR: no current process\n");
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    if (ticks) {
+        current_proc->state = PROC_SLEEPING;
+        timer_add(&current_proc->sleep_timer, ticks);
+
+        /* CPU 0 drives the wheel and may be in a one-shot aimed past
+           this deadline; a kick makes it re-aim */
+        smp_kick(0);
+    }
+    scheduler_context_switch();
+    irq_restore(flags);
+}
+
+// --- State Management ---
+/* For another process, from the outside. A RUNNING process cannot be
+   moved, since its state belongs to the CPU it runs on (a process
+   changes its own by blocking, sleeping, yielding or exiting), nor can
+   one that is gone. Returns -1 if nothing was changed. */
+int process_set_state(int pid, proc_state_t state) {
+    /* Looked up under proc_lock, or process_reap() may reclaim it */
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    pcb_t *p = find_locked(pid);
+    if (!p) {
+        spin_unlock_irqrestore(&proc_lock, flags);
+        klog(LOG_ERROR, LOG_PROC, "[process] ERROR: invalid PID\n");
+        return -1;
+    }
+
+    proc_state_t old = p->state;
+    if (old == PROC_UNUSED || old == PROC_TERMINATED || old == PROC_RUNNING ||
+        state == PROC_RUNNING || state == PROC_UNUSED) {
+        spin_unlock_irqrestore(&proc_lock, flags);
+        klog(LOG_WARN, LOG_PROC, "[process] WARNING: state change refused\n");
+        return -1;
+    }
+
+    /* Keep the run queues in step: a PCB is queued iff it is READY. It
+       is off its queue before it stops being READY and READY before it
+       goes on one, since another CPU may pick it as soon as it is. */
+    if (old == PROC_READY && state != PROC_READY && scheduler_dequeue(p) < 0) {
+        /* Picked by another CPU in the meantime */
+        spin_unlock_irqrestore(&proc_lock, flags);
+        klog(LOG_WARN, LOG_PROC, "[process] WARNING: state of a running or dead process not changed\n");
+        return -1;
+    }
+    /* A caller resumed before its reply would give back the pin its
+       request still holds, and could take a stale reply for a later
+       call. It can only be killed. */
+    if (old == PROC_BLOCKED && p->ipc_wait == IPC_WAIT_REPLY &&
+        state != PROC_BLOCKED && state != PROC_TERMINATED) {
+        spin_unlock_irqrestore(&proc_lock, flags);
+        klog(LOG_WARN, LOG_PROC, "[process] WARNING: state of a process waiting for a reply not changed\n");
+        return -1;
+    }
+    if (old == PROC_SLEEPING && state != PROC_SLEEPING)
+        timer_cancel(&p->sleep_timer);
+    if (old == PROC_BLOCKED && state != PROC_BLOCKED && ipc_abort(p) < 0) {
+        /* Already on its way back to READY from an IPC wakeup */
+        spin_unlock_irqrestore(&proc_lock, flags);
+        return -1;
+    }
+    if (state == PROC_TERMINATED) {
+        terminate_unlock(p, flags);
+    } else {
+        p->state = state;
+        if (old != PROC_READY && state == PROC_READY)
+            scheduler_enqueue(p);
+        spin_unlock_irqrestore(&proc_lock, flags);
+    }
+
+    if (log_on(LOG_INFO, LOG_PROC)) {
+        serial_puts("[process] PID ");
+        serial_put_num(pid);
+        serial_puts(" state changed\n");
+    }
+    return 0;
+}
+
+proc_state_t process_get_state(int pid) {
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    pcb_t *p = find_locked(pid);
+    proc_state_t state = p ? p->state : PROC_UNUSED;
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return state;
+}
+
+// --- Event Waits ---
+/*
+ * For drivers whose data arrives by interrupt. The waiter publishes
+ * IPC_WAIT_EVENT before it checks `ready` one last time, and the
+ * handler publishes its data before it looks at ipc_wait, so a wakeup
+ * that races with going to sleep is never lost. Callers loop until
+ * their condition holds.
+ */
+void process_wait_event(int (*ready)(void)) {
+    pcb_t *self = current_proc;
+    uint32_t flags = irq_save();
+
+    self->state = PROC_BLOCKED;
+    self->ipc_wait = IPC_WAIT_EVENT;
+
+    memory_barrier();
+    if (ready() &&
+        cmpxchg(&self->ipc_wait, IPC_WAIT_EVENT, IPC_WAIT_NONE) == IPC_WAIT_EVENT)
+        self->state = PROC_RUNNING;
+    else
+        scheduler_context_switch();
+    irq_restore(flags);
+}
+
+/* Safe from interrupt handlers; does nothing unless `p` is waiting */
+void process_wake_event(pcb_t *p) {
+    memory_barrier();
+    if (p && p->ipc_wait == IPC_WAIT_EVENT &&
+        cmpxchg(&p->ipc_wait, IPC_WAIT_EVENT, IPC_WAIT_NONE) == IPC_WAIT_EVENT)
+        ipc_wake(p);
+}
+
+// --- Process Utilities ---
+/* The table may be regrown under us, so it is only walked under
+   proc_lock. The PCB returned stays valid until the process exits and
+   is reaped. */
+pcb_t* process_get(int pid) {
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    pcb_t *p = find_locked(pid);
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return p;
+}
+
+int process_current_pid(void) {
+    if (!current_proc)
+        return -1;
+    return current_proc->pid;
+}
+
+uint32_t process_count_active(void) {
+    uint32_t count = 0;
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    for (uint32_t i = 0; i < proc_table_size; i++) {
+        if (proc_table[i] && proc_table[i]->state != PROC_UNUSED)
+            count++;
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return count;
+}
+
+/* Printed under proc_lock; with the TX ring full, serial output is
+   dropped rather than waited for, so this cannot stall */
+void process_list(void) {
+    serial_puts("\n========== PROCESS TABLE ==========\n");
+    
+    uint32_t count = 0;
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    for (uint32_t i = 0; i < proc_table_size; i++) {
+        pcb_t *p = proc_table[i];
+        if (p && p->state != PROC_UNUSED) {
+            count++;
+            serial_puts("PID ");
+            serial_put_num(p->pid);
+            serial_puts(": state=");
+            
+            switch (p->state) {
+                case PROC_READY:      serial_puts("READY"); break;
+                case PROC_RUNNING:    serial_puts("RUNNING"); break;
+                case PROC_BLOCKED:    serial_puts("BLOCKED"); break;
+                case PROC_SLEEPING:   serial_puts("SLEEPING"); break;
+                case PROC_TERMINATED: serial_puts("TERMINATED"); break;
+                default:              serial_puts("UNKNOWN");
+            }
+            serial_puts(", priority=");
+            serial_put_num(p->priority);
+            if (p->priority != p->base_priority) {
+                serial_puts(" (base ");
+                serial_put_num(p->base_priority);
+                serial_puts(")");
+            }
+            serial_puts(", cpu=");
+            serial_put_num(p->cpu);
+
+            /* Include the slice it is in the middle of */
+            uint64_t runtime = p->runtime;
+            if (p->state == PROC_RUNNING && p->run_start)
+                runtime += rdtsc() - p->run_start;
+            serial_puts("\n    run=");
+            serial_put_num(tsc_to_us(runtime) / 1000);
+            serial_puts("ms, ready=");
+            serial_put_num(tsc_to_us(p->wait_time) / 1000);
+            serial_puts("ms, switches=");
+            serial_put_num(p->nr_switches);
+            serial_puts("\n");
+        }
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+    
+    serial_puts("Total processes: ");
+    serial_put_num(count);
+    serial_puts("\n");
+    serial_puts("===================================\n\n");
+}
+
+// --- Stack Cache Control ---
+uint32_t process_stack_cache_warm(uint32_t count) {
+    if (count > STACK_CACHE_SIZE)
+        count = STACK_CACHE_SIZE;
+
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    while (stack_cache_count < count) {
+        void *stack = guarded_stack_alloc(KERNEL_STACK_SIZE);
+        if (!stack)
+            break;
+        memset(stack, 0, KERNEL_STACK_SIZE);
+        stack_cache[stack_cache_count++] = stack;
+    }
+    count = stack_cache_count;
+    spin_unlock_irqrestore(&proc_lock, flags);
+
+    return count;
+}
+
+void process_stack_cache_stats(void) {
+    serial_puts("\n========== STACK CACHE ==========\n");
+    serial_puts("Cached stacks: ");
+    serial_put_num(stack_cache_count);
+    serial_puts(" / ");
+    serial_put_num(STACK_CACHE_SIZE);
+    serial_puts(" (");
+    serial_put_num(KERNEL_STACK_SIZE / 1024);
+    serial_puts("KB each)\n");
+
+    serial_puts("Hits: ");
+    serial_put_num(stack_cache_stats.hits);
+    serial_puts(", misses: ");
+    serial_put_num(stack_cache_stats.misses);
+    serial_puts("\n");
+
+    serial_puts("Recycled: ");
+    serial_put_num(stack_cache_stats.recycled);
+    serial_puts(", overflowed to allocator: ");
+    serial_put_num(stack_cache_stats.overflows);
+    serial_puts("\n");
+    serial_puts("=================================\n\n");
+}
+
+// --- Inter-Process Communication ---
+/*
+ * A receiver with an empty mailbox blocks with ipc_wait = IPC_WAIT_RECV.
+ * A sender that publishes into the mailbox and then finds it waiting
+ * claims the wakeup and switches straight to it (scheduler_handoff), so
+ * a request/reply pair costs two switches and no run queue search. A
+ * sender that finds the mailbox full can wait for room on the
+ * receiver's send_waiters list, up to a timeout.
+ *
+ * ipc_call() is a send that blocks for the reply (IPC_WAIT_REPLY). The
+ * request carries the caller's PCB as a reply capability, and the server
+ * answers through ipc_reply_wait(), which replies and waits for the next
+ * request in one go: with nothing else queued it switches straight back
+ * into the caller. Each direction is one handoff that lends the rest of
+ * the quantum, and a server serving a higher priority caller runs on
+ * that priority until it replies.
+ *
+ * Payloads bigger than a word travel as page grants (grant.c): the
+ * pages are mapped into the receiver's private window and the message
+ * only carries the address they landed at.
+ *
+ * Both sides publish first and look second (mailbox, then ipc_wait for
+ * the sender; ipc_wait, then mailbox for the receiver) with a full fence
+ * in between, so at least one of them sees the other and no wakeup is
+ * lost.
+ */
+
+/* Look up the destination and keep its PCB from being reclaimed while
+   we write into its mailbox; process_unpin() lets it go. The pin is
+   recorded so that killing us halfway through does not leak it. */
+static pcb_t* process_pin(int pid) {
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    pcb_t *p = find_locked(pid);
+
+    if (p && p->state != PROC_UNUSED && p->state != PROC_TERMINATED) {
+        atomic_inc(&p->senders);
+        current_proc->pinned = p;
+    } else {
+        p = 0;
+    }
+    spin_unlock_irqrestore(&proc_lock, flags);
+    return p;
+}
+
+/* Interrupts off, so we cannot be switched out and killed in between */
+static void process_unpin(pcb_t *p) {
+    uint32_t flags = irq_save();
+    current_proc->pinned = 0;
+    atomic_dec(&p->senders);
+    irq_restore(flags);
+}
+
+/* Called with interrupts off right after a message went into `dest` */
+static void wake_receiver(pcb_t *dest) {
+    memory_barrier();
+    if (dest->ipc_wait != IPC_WAIT_RECV ||
+        cmpxchg(&dest->ipc_wait, IPC_WAIT_RECV, IPC_WAIT_NONE) != IPC_WAIT_RECV)
+        return;
+
+    if (scheduler_handoff(dest) < 0)
+        ipc_wake(dest);
+}
+
+/* Mailbox full: queue on the receiver and block until a slot is
+   drained or `deadline` passes. Returns -1 on timeout or if the
+   receiver exits. */
+static int wait_for_room(pcb_t *self, pcb_t *dest, uint32_t timeout, uint32_t deadline) {
+    uint32_t left = deadline - timer_now();
+
+    if (timeout == 0 || (timeout != IPC_FOREVER && (int32_t)left <= 0) ||
+        dest->state == PROC_TERMINATED)
+        return -1;
+
+    uint32_t flags = irq_save();
+    spin_lock(&dest->ipc_lock);
+    self->state = PROC_BLOCKED;
+    self->ipc_wait = IPC_WAIT_SEND;
+    self->ipc_next = 0;
+
+    pcb_t **link = &dest->send_waiters;
+    while (*link)
+        link = &(*link)->ipc_next;
+    *link = self;
+    spin_unlock(&dest->ipc_lock);
+
+    /* The owner may have drained a slot or exited before it could see
+       us queued */
+    memory_barrier();
+    if ((!mailbox_full(&dest->mailbox) || dest->state == PROC_TERMINATED) &&
+        cmpxchg(&self->ipc_wait, IPC_WAIT_SEND, IPC_WAIT_NONE) == IPC_WAIT_SEND) {
+        self->state = PROC_RUNNING;
+    } else {
+        if (timeout != IPC_FOREVER)
+            timer_add(&self->ipc_timer, left > TIMER_MAX_DELAY ? TIMER_MAX_DELAY : left);
+        scheduler_context_switch();
+        timer_cancel(&self->ipc_timer);
+    }
+
+    spin_lock(&dest->ipc_lock);
+    unlink_sender(dest, self);
+    spin_unlock(&dest->ipc_lock);
+    irq_restore(flags);
+    return 0;
+}
+
+/* Push `value` into a pinned `dest`, waiting up to `timeout` for room,
+   and wake it if it is blocked in process_receive() */
+static int send_pinned(pcb_t *self, pcb_t *dest, uint32_t value, uint32_t timeout) {
+    message_t msg = { self->pid, value, 0 };
+    uint32_t deadline = timer_now() + timeout;
+    int ret;
+
+    for (;;) {
+        /* A claimed slot reads as empty until it is published, so do
+           not get preempted in between */
+        uint32_t flags = irq_save();
+        ret = mailbox_push(&dest->mailbox, &msg);
+        irq_restore(flags);
+        if (ret == 0 || wait_for_room(self, dest, timeout, deadline) < 0)
+            break;
+    }
+
+    if (ret < 0) {
+        klog(LOG_WARN, LOG_IPC, "[IPC] WARNING: message queue full\n");
+        return -1;
+    }
+
+    /* Messages are too frequent to log; the switch into a waiting
+       receiver shows up as a handoff in schedstat */
+    trace_event(TRACE_SEND, dest->pid, value);
+    uint32_t flags = irq_save();
+    wake_receiver(dest);
+    irq_restore(flags);
+    return 0;
+}
+
+/* Wait up to `timeout` ticks (IPC_FOREVER: no limit, 0: not at all) for
+   room in a full mailbox. A receiver blocked in process_receive() gets
+   the CPU straight away. */
+int process_send_timeout(int dest_pid, uint32_t value, uint32_t timeout) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    pcb_t *dest = process_pin(dest_pid);
+    if (!dest) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: invalid destination PID\n");
+        return -1;
+    }
+
+    int ret = send_pinned(self, dest, value, timeout);
+    process_unpin(dest);
+    return ret;
+}
+
+int process_send(int dest_pid, uint32_t value) {
+    return process_send_timeout(dest_pid, value, 0);
+}
+
+/* Send up to `count` values with one lookup and one claim on the
+   destination ring. Returns how many were sent, which is short of
+   `count` if the mailbox fills up, or -1 if there is no destination. */
+int process_send_batch(int dest_pid, const uint32_t *values, uint32_t count) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    pcb_t *dest = process_pin(dest_pid);
+    if (!dest) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: invalid destination PID\n");
+        return -1;
+    }
+
+    uint32_t flags = irq_save();
+    uint32_t sent = mailbox_push_batch(&dest->mailbox, self->pid, values, count);
+    if (sent)
+        wake_receiver(dest);
+    irq_restore(flags);
+    process_unpin(dest);
+
+    return sent;
+}
+
+/* Hand the grant at `buf` over without copying it: the receiver gets a
+   message whose value is where the same pages sit in its own window,
+   and lets go of them with grant_free(). GRANT_MOVE also drops the
+   sender's mapping once the message is out; GRANT_SHARE keeps it. */
+int process_send_grant(int dest_pid, void *buf, uint32_t mode, uint32_t timeout) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    pcb_t *dest = process_pin(dest_pid);
+    if (!dest) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: invalid destination PID\n");
+        return -1;
+    }
+
+    /* Mapped before the message is published, so the receiver can use
+       it the moment it is received */
+    uint32_t vaddr = grant_map_into(dest, buf);
+    if (!vaddr) {
+        process_unpin(dest);
+        if (log_on(LOG_ERROR, LOG_IPC)) {
+            serial_puts("[IPC] ERROR: cannot grant to PID ");
+            serial_put_num(dest_pid);
+            serial_puts("\n");
+        }
+        return -1;
+    }
+
+    if (send_pinned(self, dest, vaddr, timeout) < 0) {
+        grant_drop(dest, vaddr);
+        process_unpin(dest);
+        return -1;
+    }
+    process_unpin(dest);
+
+    if (mode == GRANT_MOVE)
+        grant_free(buf);
+    return 0;
+}
+
+/*
+ * Pop the next message, blocking while there is none. `caller`, if set,
+ * is a process whose wakeup we have claimed: if we have to block it
+ * gets the CPU directly, otherwise it is simply made READY.
+ */
+static void wait_for_message(pcb_t *self, message_t *msg, pcb_t *caller) {
+    while (mailbox_pop(&self->mailbox, msg) < 0) {
+        uint32_t flags = irq_save();
+
+        self->state = PROC_BLOCKED;
+        (void)cmpxchg(&self->ipc_wait, IPC_WAIT_NONE, IPC_WAIT_RECV);
+
+        /* A sender may have published before it could see us waiting */
+        if (mailbox_ready(&self->mailbox) &&
+            cmpxchg(&self->ipc_wait, IPC_WAIT_RECV, IPC_WAIT_NONE) == IPC_WAIT_RECV) {
+            self->state = PROC_RUNNING;
+        } else if (caller && scheduler_handoff(caller) == 0) {
+            caller = 0;
+        } else {
+            if (caller)
+                ipc_wake(caller);
+            caller = 0;
+            scheduler_context_switch();
+        }
+        irq_restore(flags);
+    }
+
+    if (caller)
+        ipc_wake(caller);
+    trace_event(TRACE_RECV, msg->sender_pid, msg->value);
+}
+
+/* A request from ipc_call(): remember whom to reply to, and run on the
+   caller's priority until we do. One request is served at a time, so
+   one still unanswered is failed. */
+static void accept_message(pcb_t *self, const message_t *msg) {
+    if (!msg->reply_cap)
+        return;
+
+    if (self->reply_to)
+        fail_call(self->reply_to);
+
+    pcb_t *caller = (pcb_t*)msg->reply_cap;
+    self->reply_to = caller;
+    if (caller->priority < sched_base_priority(self))
+        scheduler_donate(self, caller->priority);
+}
+
+/* Block until a message arrives; only the owner reads its mailbox, so
+   no lock is needed */
+int process_receive(uint32_t *out_value) {
+    pcb_t *self = current_proc;
+    message_t msg;
+
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    wait_for_message(self, &msg, 0);
+    accept_message(self, &msg);
+
+    *out_value = msg.value;
+    wake_senders(self, 0);
+    return 0;
+}
+
+/* Block until a message arrives, then take up to `max` in arrival order;
+   returns how many. An ipc_call() request ends the batch: it comes last,
+   with its reply_cap set, and is answered with ipc_reply_wait() just as
+   after process_receive(). */
+int process_receive_batch(message_t *out, uint32_t max) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+    if (!max)
+        return 0;
+
+    wait_for_message(self, &out[0], 0);
+    uint32_t n = 1;
+    if (!out[0].reply_cap)
+        n += mailbox_pop_batch(&self->mailbox, &out[1], max - 1);
+    accept_message(self, &out[n - 1]);
+
+    wake_senders(self, 0);
+    return n;
+}
+
+// --- Synchronous IPC ---
+/* Send `msg` and block until the server answers with ipc_reply_wait().
+   Returns -1 if the request cannot be queued or the server exits
+   without replying. */
+int ipc_call(int dest_pid, uint32_t msg, uint32_t *reply) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    pcb_t *dest = process_pin(dest_pid);
+    if (!dest) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: invalid destination PID\n");
+        return -1;
+    }
+
+    message_t call = { self->pid, msg, (uint32_t)self };
+    uint32_t flags = irq_save();
+
+    /* Waiting before the request is out, since the reply may come from
+       another CPU as soon as it is. The request pins us until we are
+       woken, see put_reply_cap(). */
+    self->ipc_replied = 0;
+    self->ipc_wait = IPC_WAIT_REPLY;
+    self->state = PROC_BLOCKED;
+    atomic_inc(&self->senders);
+
+    if (mailbox_push(&dest->mailbox, &call) < 0) {
+        put_reply_cap(self);
+        self->ipc_wait = IPC_WAIT_NONE;
+        self->state = PROC_RUNNING;
+        irq_restore(flags);
+        process_unpin(dest);
+        klog(LOG_WARN, LOG_IPC, "[IPC] WARNING: message queue full\n");
+        return -1;
+    }
+
+    trace_event(TRACE_CALL, dest->pid, msg);
+    if (self->priority < sched_base_priority(dest))
+        scheduler_donate(dest, self->priority);
+
+    int woken = 1;
+
+    memory_barrier();
+    if (dest->state == PROC_TERMINATED &&
+        cmpxchg(&self->ipc_wait, IPC_WAIT_REPLY, IPC_WAIT_NONE) == IPC_WAIT_REPLY) {
+        /* Too late for its exit to have seen the request, which still
+           holds the pin until the PCB is reclaimed */
+        self->state = PROC_RUNNING;
+        woken = 0;
+    } else if (dest->ipc_wait == IPC_WAIT_RECV &&
+               cmpxchg(&dest->ipc_wait, IPC_WAIT_RECV, IPC_WAIT_NONE) == IPC_WAIT_RECV) {
+        if (scheduler_handoff(dest) < 0) {
+            ipc_wake(dest);
+            scheduler_context_switch();
+        }
+    } else {
+        scheduler_context_switch();
+    }
+
+    irq_restore(flags);
+    process_unpin(dest);
+    if (woken)
+        put_reply_cap(self);
+
+    if (!self->ipc_replied) {
+        if (log_on(LOG_ERROR, LOG_IPC)) {
+            serial_puts("[IPC] ERROR: no reply from PID ");
+            serial_put_num(dest_pid);
+            serial_puts("\n");
+        }
+        return -1;
+    }
+
+    *reply = self->ipc_reply;
+    return 0;
+}
+
+/* Server side: answer the request being served (if any) with `reply`
+   and wait for the next message. The caller gets the CPU back directly
+   whenever there is nothing else to do. */
+int ipc_reply_wait(uint32_t reply, uint32_t *next_msg) {
+    pcb_t *self = current_proc;
+    if (!self) {
+        klog(LOG_ERROR, LOG_IPC, "[IPC] ERROR: no current process\n");
+        return -1;
+    }
+
+    pcb_t *caller = self->reply_to;
+    message_t msg;
+
+    self->reply_to = 0;
+    if (self->donated_priority)
+        scheduler_donate(self, 0);
+
+    /* A caller killed while waiting has left IPC_WAIT_REPLY and is only
+       kept around by its pin */
+    if (caller) {
+        caller->ipc_reply = reply;
+        caller->ipc_replied = 1;
+        if (cmpxchg(&caller->ipc_wait, IPC_WAIT_REPLY, IPC_WAIT_NONE) != IPC_WAIT_REPLY) {
+            put_reply_cap(caller);
+            caller = 0;
+        }
+    }
+
+    wait_for_message(self, &msg, caller);
+    accept_message(self, &msg);
+
+    *next_msg = msg.value;
+    wake_senders(self, 0);
+    return 0;
+}
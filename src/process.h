@@ -1,65 +1,133 @@
-#ifndef PROCESS_H
-#define PROCESS_H
-
-#include "types.h"
-
-// --- Configuration ---
-#define MAX_PROCESSES 16
-#define MAX_MESSAGES  8
-
-// --- Process States ---
-typedef enum {
-    PROC_UNUSED = 0,
-    PROC_READY,
-    PROC_RUNNING,
-    PROC_BLOCKED,
-    PROC_SLEEPING,
-    PROC_TERMINATED
-} proc_state_t;
-
-// --- IPC Message Structure ---
-typedef struct {
-    uint32_t sender_pid;
-    uint32_t value;
-} message_t;
-
-// --- Process Control Block ---
-typedef struct pcb {
-    uint32_t pid;
-    proc_state_t state;
-
-    uint32_t *stack_base;
-    uint32_t *stack_ptr;
-
-    uint32_t priority;
-    uint32_t age;
-
-    message_t msg_queue[MAX_MESSAGES];
-    uint32_t msg_count;
-
-} pcb_t;
-
-// --- Global Process Table ---
-extern pcb_t proc_table[MAX_PROCESSES];
-extern pcb_t *current_proc;
-
-// --- Process Management API ---
-void process_init(void);
-int  process_create(void (*entry)(void), uint32_t priority);
-void process_exit(void);
-
-// --- State Management ---
-void process_set_state(int pid, proc_state_t state);
-proc_state_t process_get_state(int pid);
-
-// --- Process Utilities ---
-pcb_t* process_get(int pid);
-int process_current_pid(void);
-uint32_t process_count_active(void);
-void process_list(void);
-
-// --- Inter-Process Communication ---
-int process_send(int dest_pid, uint32_t value);
-int process_receive(uint32_t *out_value);
-
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "types.h"
+#include "rbtree.h"
+#include "timer.h"
+#include "spinlock.h"
+#include "mailbox.h"
+#include "grant.h"
+
+// --- Configuration ---
+#define PROC_TABLE_INITIAL 16     /* doubled whenever the table fills */
+#define STACK_CACHE_SIZE 32     /* default-size stacks kept for reuse */
+
+// --- Process States ---
+typedef enum {
+    PROC_UNUSED = 0,
+    PROC_READY,
+    PROC_RUNNING,
+    PROC_BLOCKED,
+    PROC_SLEEPING,
+    PROC_TERMINATED
+} proc_state_t;
+
+// --- IPC Wait States ---
+/* What a PROC_BLOCKED process waits for. Whoever moves it back to
+   IPC_WAIT_NONE with cmpxchg owns waking it. */
+#define IPC_WAIT_NONE   0
+#define IPC_WAIT_RECV   1       /* for a message in its own mailbox */
+#define IPC_WAIT_SEND   2       /* for room in a full receiver's mailbox */
+#define IPC_WAIT_REPLY  3       /* in ipc_call(), for the server's reply */
+#define IPC_WAIT_EVENT  4       /* in process_wait_event(), for a driver */
+
+#define IPC_FOREVER     0xFFFFFFFFu     /* send timeout: no limit */
+
+// --- Process Control Block ---
+typedef struct pcb {
+    uint32_t pid;
+    proc_state_t state;
+
+    uint32_t *stack_base;
+    uint32_t *stack_ptr;
+    uint32_t stack_size;        /* usable, below it is the guard page */
+    uint32_t page_dir;          /* physical address loaded into CR3 */
+    void (*entry)(void);        /* started by process_trampoline */
+
+    uint32_t base_priority;     /* as requested at creation */
+    uint32_t priority;          /* effective: base minus aging boosts */
+    uint32_t donated_priority;  /* lent by a blocked IPC caller, 0 = none */
+    uint32_t age;               /* boosts since it last ran */
+    uint32_t enqueue_tick;      /* scheduler tick it joined its run queue */
+    struct pcb *rq_next;        /* run queue links, valid while READY */
+    struct pcb *rq_prev;
+    uint32_t rq_level;          /* run queue level it is linked on */
+    uint32_t mlfq_level;        /* MLFQ: 0 is the top level */
+    uint32_t cpu;               /* whose run queue it belongs to */
+    uint32_t on_rq;             /* linked on that run queue */
+    volatile uint32_t on_cpu;   /* a CPU still runs on its stack */
+    uint32_t slot;              /* index in the process table */
+    struct pcb *dead_next;      /* link on the reaper list, valid while TERMINATED */
+    rb_node_t cfs_node;         /* CFS: timeline link, valid while READY */
+    uint64_t vruntime;          /* CFS: weighted run time, us */
+    uint32_t run_ticks;         /* ticks spent RUNNING */
+    uint64_t runtime;           /* TSC cycles spent RUNNING */
+    uint64_t wait_time;         /* TSC cycles spent READY */
+    uint64_t run_start;         /* TSC when last dispatched */
+    uint64_t ready_since;       /* TSC when it became READY, 0 otherwise */
+    uint32_t nr_switches;       /* times dispatched */
+    ktimer_t sleep_timer;       /* wakes the process from PROC_SLEEPING */
+
+    mailbox_t mailbox;          /* lock-free, sized at creation */
+    volatile uint32_t senders;  /* pins: senders still writing into it and
+                                   its ipc_call() requests not answered */
+    volatile uint32_t ipc_wait; /* IPC_WAIT_*, see above */
+    spinlock_t ipc_lock;        /* guards send_waiters */
+    struct pcb *send_waiters;   /* blocked on our full mailbox, FIFO */
+    struct pcb *ipc_next;       /* link on the receiver's send_waiters */
+    ktimer_t ipc_timer;         /* send timeout */
+    struct pcb *pinned;         /* destination it holds, see process_pin() */
+    struct pcb *reply_to;       /* caller of the request being served */
+    uint32_t ipc_reply;         /* reply value, valid once ipc_replied */
+    volatile uint32_t ipc_replied;
+    grant_t *grants[GRANT_SLOTS]; /* held page grants, by window slot */
+
+} pcb_t;
+
+// --- Global Process Table ---
+/* current_proc is per-CPU, see smp.h */
+extern pcb_t **proc_table;
+extern uint32_t proc_table_size;
+extern spinlock_t proc_lock;
+
+// --- Process Management API ---
+void process_init(void);
+int  process_create(void (*entry)(void), uint32_t priority, uint32_t stack_size,
+                    uint32_t mailbox_size);
+int  process_create_blocked(void (*entry)(void), uint32_t priority, uint32_t stack_size,
+                            uint32_t mailbox_size);
+void process_exit(void);
+void process_reap(void);
+void process_sleep(uint32_t ticks);
+
+// --- State Management ---
+int  process_set_state(int pid, proc_state_t state);
+proc_state_t process_get_state(int pid);
+
+// --- Event Waits ---
+void process_wait_event(int (*ready)(void));
+void process_wake_event(pcb_t *p);
+
+// --- Process Utilities ---
+pcb_t* process_get(int pid);
+int process_current_pid(void);
+uint32_t process_count_active(void);
+void process_list(void);
+
+// --- Stack Cache ---
+uint32_t process_stack_cache_warm(uint32_t count);
+void process_stack_cache_stats(void);
+
+// --- Inter-Process Communication ---
+int process_send(int dest_pid, uint32_t value);
+int process_send_timeout(int dest_pid, uint32_t value, uint32_t timeout);
+int process_receive(uint32_t *out_value);
+int process_send_batch(int dest_pid, const uint32_t *values, uint32_t count);
+int process_receive_batch(message_t *out, uint32_t max);
+int process_send_grant(int dest_pid, void *buf, uint32_t mode, uint32_t timeout);
+
+// --- Synchronous IPC ---
+int ipc_call(int dest_pid, uint32_t msg, uint32_t *reply);
+int ipc_reply_wait(uint32_t reply, uint32_t *next_msg);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,255 @@
+// --- Red-Black Tree ---
+#include "rbtree.h"
+
+/* NULL children count as black leaves */
+static inline int is_red(rb_node_t *node)
+{
+    return node && node->red;
+}
+
+// --- Rotations ---
+static void replace_child(rb_root_t *root, rb_node_t *parent,
+                          rb_node_t *old, rb_node_t *new)
+{
+    if (!parent)
+        root->node = new;
+    else if (parent->left == old)
+        parent->left = new;
+    else
+        parent->right = new;
+}
+
+static void rotate_left(rb_root_t *root, rb_node_t *x)
+{
+    rb_node_t *y = x->right;
+
+    x->right = y->left;
+    if (y->left)
+        y->left->parent = x;
+    y->parent = x->parent;
+    replace_child(root, x->parent, x, y);
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(rb_root_t *root, rb_node_t *x)
+{
+    rb_node_t *y = x->left;
+
+    x->left = y->right;
+    if (y->right)
+        y->right->parent = x;
+    y->parent = x->parent;
+    replace_child(root, x->parent, x, y);
+    y->right = x;
+    x->parent = y;
+}
+
+// --- Insertion ---
+void rb_insert_color(rb_node_t *node, rb_root_t *root)
+{
+    rb_node_t *parent;
+
+    while ((parent = node->parent) && parent->red)
+    {
+        rb_node_t *gparent = parent->parent;
+
+        if (parent == gparent->left)
+        {
+            rb_node_t *uncle = gparent->right;
+
+            if (is_red(uncle))
+            {
+                parent->red = uncle->red = 0;
+                gparent->red = 1;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right)
+            {
+                rotate_left(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = 0;
+            gparent->red = 1;
+            rotate_right(root, gparent);
+        }
+        else
+        {
+            rb_node_t *uncle = gparent->left;
+
+            if (is_red(uncle))
+            {
+                parent->red = uncle->red = 0;
+                gparent->red = 1;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left)
+            {
+                rotate_right(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = 0;
+            gparent->red = 1;
+            rotate_left(root, gparent);
+        }
+    }
+
+    root->node->red = 0;
+}
+
+// --- Deletion ---
+/* Restore the black height after removing a black node above `node`
+   (which may be NULL) under `parent` */
+static void erase_fixup(rb_root_t *root, rb_node_t *node, rb_node_t *parent)
+{
+    while (node != root->node && !is_red(node))
+    {
+        if (node == parent->left)
+        {
+            rb_node_t *sib = parent->right;
+
+            if (is_red(sib))
+            {
+                sib->red = 0;
+                parent->red = 1;
+                rotate_left(root, parent);
+                sib = parent->right;
+            }
+            if (!is_red(sib->left) && !is_red(sib->right))
+            {
+                sib->red = 1;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!is_red(sib->right))
+            {
+                sib->left->red = 0;
+                sib->red = 1;
+                rotate_right(root, sib);
+                sib = parent->right;
+            }
+            sib->red = parent->red;
+            parent->red = 0;
+            sib->right->red = 0;
+            rotate_left(root, parent);
+            node = root->node;
+        }
+        else
+        {
+            rb_node_t *sib = parent->left;
+
+            if (is_red(sib))
+            {
+                sib->red = 0;
+                parent->red = 1;
+                rotate_right(root, parent);
+                sib = parent->left;
+            }
+            if (!is_red(sib->left) && !is_red(sib->right))
+            {
+                sib->red = 1;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!is_red(sib->left))
+            {
+                sib->right->red = 0;
+                sib->red = 1;
+                rotate_left(root, sib);
+                sib = parent->left;
+            }
+            sib->red = parent->red;
+            parent->red = 0;
+            sib->left->red = 0;
+            rotate_right(root, parent);
+            node = root->node;
+        }
+    }
+
+    if (node)
+        node->red = 0;
+}
+
+void rb_erase(rb_node_t *node, rb_root_t *root)
+{
+    rb_node_t *child, *parent;
+    int was_red;
+
+    if (node->left && node->right)
+    {
+        /* Swap in the in-order successor, which has no left child */
+        rb_node_t *succ = node->right;
+
+        while (succ->left)
+            succ = succ->left;
+
+        child = succ->right;
+        parent = succ->parent;
+        was_red = succ->red;
+
+        if (parent == node)
+        {
+            parent = succ;
+        }
+        else
+        {
+            parent->left = child;
+            if (child)
+                child->parent = parent;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->parent = node->parent;
+        succ->red = node->red;
+        replace_child(root, node->parent, node, succ);
+    }
+    else
+    {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        was_red = node->red;
+
+        if (child)
+            child->parent = parent;
+        replace_child(root, parent, node, child);
+    }
+
+    if (!was_red)
+        erase_fixup(root, child, parent);
+}
+
+// --- Traversal ---
+rb_node_t* rb_first(rb_root_t *root)
+{
+    rb_node_t *node = root->node;
+
+    if (!node)
+        return NULL;
+    while (node->left)
+        node = node->left;
+    return node;
+}
+
+rb_node_t* rb_next(rb_node_t *node)
+{
+    if (node->right)
+    {
+        node = node->right;
+        while (node->left)
+            node = node->left;
+        return node;
+    }
+
+    while (node->parent && node == node->parent->right)
+        node = node->parent;
+    return node->parent;
+}
@@ -0,0 +1,41 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include "types.h"
+
+// --- Intrusive Red-Black Tree ---
+/*
+ * The node is embedded in the object being sorted and the caller does
+ * the ordered descent itself, then links the node with rb_link_node()
+ * and rebalances with rb_insert_color(). rb_entry() gets back from a
+ * node to its containing object.
+ */
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    int red;
+} rb_node_t;
+
+typedef struct {
+    rb_node_t *node;
+} rb_root_t;
+
+#define rb_entry(ptr, type, member) \
+    ((type*)((uint8_t*)(ptr) - __builtin_offsetof(type, member)))
+
+static inline void rb_link_node(rb_node_t *node, rb_node_t *parent, rb_node_t **link)
+{
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->red = 1;
+    *link = node;
+}
+
+// --- Red-Black Tree API ---
+void rb_insert_color(rb_node_t *node, rb_root_t *root);
+void rb_erase(rb_node_t *node, rb_root_t *root);
+rb_node_t* rb_first(rb_root_t *root);
+rb_node_t* rb_next(rb_node_t *node);
+
+#endif
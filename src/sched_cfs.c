@@ -0,0 +1,194 @@
+// --- Completely Fair Scheduling Policy ---
+#include "scheduler.h"
+#include "smp.h"
+#include "serial.h"
+#include "pit.h"
+
+/*
+ * Every process accumulates virtual runtime while it runs, scaled down by
+ * its weight so higher priorities age slower. READY processes sit in a
+ * red-black tree ordered by vruntime and the leftmost one (cached) runs
+ * next. Slices share CFS_TARGET_LATENCY between the queued processes in
+ * proportion to weight. min_vruntime only moves forward and anchors new
+ * and woken processes, so a long sleeper cannot come back and monopolize
+ * the CPU to "catch up". Each CPU has its own timeline and min_vruntime.
+ */
+
+#define TICK_US  (1000000 / TIMER_HZ)
+
+/* Priority 1..20 -> weight, ~1.25x per step, priority 10 = 1024 */
+static const uint32_t prio_to_weight[MAX_PRIORITY + 1] = {
+    0,
+    7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277, 1024,
+    820,  655,  526,  423,  335,  272,  215,  172,  137,  110,
+};
+
+static inline uint32_t cfs_weight(pcb_t *p)
+{
+    return prio_to_weight[sched_base_priority(p)];
+}
+
+static void update_min_vruntime(scheduler_t *s)
+{
+    uint64_t v = s->min_vruntime;
+    int have = 0;
+
+    if (current_proc && current_proc->state == PROC_RUNNING)
+    {
+        v = current_proc->vruntime;
+        have = 1;
+    }
+    if (s->cfs_leftmost)
+    {
+        uint64_t left = rb_entry(s->cfs_leftmost, pcb_t, cfs_node)->vruntime;
+        if (!have || left < v)
+            v = left;
+    }
+
+    if (v > s->min_vruntime)
+        s->min_vruntime = v;
+}
+
+// --- Policy Hooks ---
+static void cfs_admit(scheduler_t *s, pcb_t *p)
+{
+    p->vruntime = s->min_vruntime;
+}
+
+static void cfs_enqueue(scheduler_t *s, pcb_t *p)
+{
+    uint64_t floor = s->min_vruntime > CFS_WAKEUP_CREDIT ?
+                     s->min_vruntime - CFS_WAKEUP_CREDIT : 0;
+    rb_node_t **link = &s->cfs_timeline.node;
+    rb_node_t *parent = NULL;
+    int leftmost = 1;
+
+    if (p->vruntime < floor)
+        p->vruntime = floor;
+
+    /* Equal keys go right, so ties run in FIFO order */
+    while (*link)
+    {
+        parent = *link;
+        if (p->vruntime < rb_entry(parent, pcb_t, cfs_node)->vruntime)
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+
+    rb_link_node(&p->cfs_node, parent, link);
+    rb_insert_color(&p->cfs_node, &s->cfs_timeline);
+
+    if (leftmost)
+        s->cfs_leftmost = &p->cfs_node;
+    s->cfs_weight += cfs_weight(p);
+}
+
+static void cfs_dequeue(scheduler_t *s, pcb_t *p)
+{
+    if (s->cfs_leftmost == &p->cfs_node)
+        s->cfs_leftmost = rb_next(&p->cfs_node);
+
+    rb_erase(&p->cfs_node, &s->cfs_timeline);
+    s->cfs_weight -= cfs_weight(p);
+}
+
+static pcb_t* cfs_pick(scheduler_t *s)
+{
+    if (!s->cfs_leftmost)
+        return NULL;
+    return rb_entry(s->cfs_leftmost, pcb_t, cfs_node);
+}
+
+static void cfs_age(scheduler_t *s)
+{
+    if (current_proc && current_proc->state == PROC_RUNNING)
+        current_proc->vruntime += TICK_US * CFS_NICE0_WEIGHT / cfs_weight(current_proc);
+
+    update_min_vruntime(s);
+}
+
+/* Called once `p` is off the tree, so cfs_weight covers the others */
+static uint32_t cfs_quantum(scheduler_t *s, pcb_t *p)
+{
+    uint32_t weight = cfs_weight(p);
+    uint32_t slice = CFS_TARGET_LATENCY * weight / (s->cfs_weight + weight);
+
+    return slice < CFS_MIN_GRANULARITY ? CFS_MIN_GRANULARITY : slice;
+}
+
+// --- Statistics ---
+static void print_lag(int64_t lag)
+{
+    uint64_t mag = lag < 0 ? (uint64_t)-lag : (uint64_t)lag;
+
+    if (lag < 0)
+        serial_putc('-');
+    serial_put_num(mag > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)mag);
+}
+
+static void cfs_print_stats(scheduler_t *s)
+{
+    struct { uint32_t pid, weight, run_ticks; int64_t lag; } rows[SCHED_STATS_ROWS];
+    uint32_t n = 0;
+    uint32_t queued = 0;
+
+    uint32_t flags = spin_lock_irqsave(&s->lock);
+    uint32_t weight = s->cfs_weight;
+    for (rb_node_t *node = rb_first(&s->cfs_timeline); node; node = rb_next(node), queued++)
+    {
+        pcb_t *p = rb_entry(node, pcb_t, cfs_node);
+
+        if (n == SCHED_STATS_ROWS)
+            continue;
+        rows[n].pid = p->pid;
+        rows[n].weight = cfs_weight(p);
+        /* Negative for tasks woken with CFS_WAKEUP_CREDIT */
+        rows[n].lag = (int64_t)(p->vruntime - s->min_vruntime);
+        rows[n].run_ticks = p->run_ticks;
+        n++;
+    }
+    spin_unlock_irqrestore(&s->lock, flags);
+
+    serial_puts("CFS queued weight: ");
+    serial_put_num(weight);
+    serial_puts("\n");
+
+    serial_puts("\nPID     weight   lag(us)   run ticks\n");
+    for (uint32_t i = 0; i < n; i++)
+    {
+        serial_puts("  ");
+        serial_put_num(rows[i].pid);
+        serial_puts("\t  ");
+        serial_put_num(rows[i].weight);
+        serial_puts("\t   ");
+        print_lag(rows[i].lag);
+        serial_puts("\t     ");
+        serial_put_num(rows[i].run_ticks);
+        serial_puts("\n");
+    }
+    if (queued > n)
+    {
+        serial_puts("  ... ");
+        serial_put_num(queued - n);
+        serial_puts(" more\n");
+    }
+}
+
+const sched_policy_t sched_cfs_policy = {
+    .name        = "cfs",
+    .admit       = cfs_admit,
+    .enqueue     = cfs_enqueue,
+    .dequeue     = cfs_dequeue,
+    .pick        = cfs_pick,
+    .dispatched  = NULL,
+    .stopped     = NULL,
+    .age         = cfs_age,
+    .quantum     = cfs_quantum,
+    .print_stats = cfs_print_stats,
+};
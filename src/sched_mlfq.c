@@ -0,0 +1,145 @@
+// --- Multi-Level Feedback Queue Policy ---
+#include "scheduler.h"
+#include "smp.h"
+#include "serial.h"
+#include "pit.h"
+
+/*
+ * MLFQ_LEVELS run queue levels, level 0 first. A process starts at
+ * level 0; using up a whole quantum moves it down a level, where the
+ * quantum is twice as long, while giving up the CPU early (blocking,
+ * yielding) keeps it where it is. Every MLFQ_BOOST_PERIOD everything
+ * goes back to level 0 so CPU-bound work sunk to the bottom cannot be
+ * starved by a stream of interactive processes. Static priorities are
+ * ignored while this policy is active. Levels and boosts are per CPU;
+ * a process stolen by another CPU starts over at level 0 there.
+ */
+
+// --- Policy Hooks ---
+static void mlfq_admit(scheduler_t *s, pcb_t *p)
+{
+    (void)s;
+    p->mlfq_level = 0;
+}
+
+static void mlfq_enqueue(scheduler_t *s, pcb_t *p)
+{
+    rq_push(&s->rq, p, p->mlfq_level);
+}
+
+static void mlfq_dequeue(scheduler_t *s, pcb_t *p)
+{
+    rq_remove(&s->rq, p);
+}
+
+static pcb_t* mlfq_pick(scheduler_t *s)
+{
+    return rq_first(&s->rq);
+}
+
+static void mlfq_stopped(scheduler_t *s, pcb_t *p, int expired)
+{
+    if (expired && p->mlfq_level < MLFQ_LEVELS - 1)
+    {
+        p->mlfq_level++;
+        s->mlfq.demotions++;
+    }
+}
+
+static uint32_t mlfq_quantum(scheduler_t *s, pcb_t *p)
+{
+    (void)s;
+    return MLFQ_BASE_QUANTUM << p->mlfq_level;
+}
+
+/* Move every queued process back to level 0, oldest first */
+static void mlfq_boost(scheduler_t *s)
+{
+    for (uint32_t level = 1; level < MLFQ_LEVELS; level++)
+    {
+        while (s->rq.head[level])
+        {
+            pcb_t *p = s->rq.head[level];
+
+            rq_remove(&s->rq, p);
+            p->mlfq_level = 0;
+            rq_push(&s->rq, p, 0);
+        }
+    }
+
+    if (current_proc)
+        current_proc->mlfq_level = 0;
+
+    s->mlfq.boosts++;
+    s->mlfq.last_boost = s->ticks;
+}
+
+static void mlfq_age(scheduler_t *s)
+{
+    if (current_proc)
+        s->mlfq.level_ticks[current_proc->mlfq_level]++;
+
+    if (s->ticks - s->mlfq.last_boost >= MS_TO_TICKS(MLFQ_BOOST_PERIOD))
+        mlfq_boost(s);
+}
+
+// --- Statistics ---
+static void mlfq_print_stats(scheduler_t *s)
+{
+    uint32_t ready[MLFQ_LEVELS] = { 0 };
+    uint32_t level_ticks[MLFQ_LEVELS];
+    uint32_t total = 0;
+
+    uint32_t flags = spin_lock_irqsave(&s->lock);
+    uint32_t demotions = s->mlfq.demotions;
+    uint32_t boosts = s->mlfq.boosts;
+    for (uint32_t level = 0; level < MLFQ_LEVELS; level++)
+    {
+        level_ticks[level] = s->mlfq.level_ticks[level];
+        for (pcb_t *p = s->rq.head[level]; p; p = p->rq_next)
+            ready[level]++;
+    }
+    spin_unlock_irqrestore(&s->lock, flags);
+
+    for (uint32_t level = 0; level < MLFQ_LEVELS; level++)
+        total += level_ticks[level];
+
+    serial_puts("MLFQ demotions: ");
+    serial_put_num(demotions);
+    serial_puts(", boosts: ");
+    serial_put_num(boosts);
+    serial_puts("\n");
+
+    serial_puts("\nLevel   quantum   ready   run ticks\n");
+    for (uint32_t level = 0; level < MLFQ_LEVELS; level++)
+    {
+        serial_puts("  ");
+        serial_put_num(level);
+        serial_puts("\t  ");
+        serial_put_num(MLFQ_BASE_QUANTUM << level);
+        serial_puts("ms\t    ");
+        serial_put_num(ready[level]);
+        serial_puts("\t    ");
+        serial_put_num(level_ticks[level]);
+        if (total)
+        {
+            serial_puts(" (");
+            serial_put_num(level_ticks[level] * 100 / total);
+            serial_puts("%)");
+        }
+        serial_puts("\n");
+    }
+}
+
+const sched_policy_t sched_mlfq_policy = {
+    .name        = "mlfq",
+    .admit       = mlfq_admit,
+    .enqueue     = mlfq_enqueue,
+    .dequeue     = mlfq_dequeue,
+    .pick        = mlfq_pick,
+    .dispatched  = NULL,
+    .stopped     = mlfq_stopped,
+    .age         = mlfq_age,
+    .quantum     = mlfq_quantum,
+    .print_stats = mlfq_print_stats,
+};
@@ -1,200 +1,1030 @@
-// --- Scheduler Implementation ---
-#include "scheduler.h"
-#include "memory.h"
-#include "serial.h"
-#include "string.h"
-#include "context_switch.h"
-
-scheduler_t scheduler;
-
-// --- Initialization ---
-void scheduler_init(void)
-{
-    scheduler.current_quantum = DEFAULT_TIME_QUANTUM;
-    scheduler.time_quantum = DEFAULT_TIME_QUANTUM;
-    scheduler.ticks = 0;
-    scheduler.context_switches = 0;
-
-    serial_puts("[scheduler] initialized with quantum=");
-    serial_put_num(DEFAULT_TIME_QUANTUM);
-    serial_puts("ms\n");
-}
-
-// --- Process Selection ---
-pcb_t* scheduler_next(void)
-{
-    pcb_t *best = NULL;
-    uint32_t best_priority = MAX_PRIORITY + 1;
-
-    for (int i = 0; i < MAX_PROCESSES; i++)
-    {
-        if (proc_table[i].state == PROC_READY)
-        {
-            if (proc_table[i].priority < best_priority)
-            {
-                best_priority = proc_table[i].priority;
-                best = &proc_table[i];
-            }
-        }
-    }
-
-    if (!best)
-    {
-        return NULL;
-    }
-
-    return best;
-}
-
-// --- Timer Tick Handler ---
-void scheduler_tick(void)
-{
-    scheduler.ticks++;
-
-    if (current_proc)
-    {
-        scheduler.current_quantum--;
-
-        if (scheduler.current_quantum == 0 && current_proc->state == PROC_RUNNING)
-        {
-            current_proc->state = PROC_READY;
-            scheduler_context_switch();
-        }
-    }
-
-    if (scheduler.ticks % AGING_THRESHOLD == 0)
-    {
-        scheduler_apply_aging();
-    }
-}
-
-// --- Context Switching ---
-void scheduler_context_switch(void)
-{
-    pcb_t *next = scheduler_next();
-
-    if (!next)
-    {
-        serial_puts("[scheduler] no READY process available\n");
-        return;
-    }
-
-    if (current_proc)
-    {
-        serial_puts("[scheduler] switch from PID ");
-        serial_put_num(current_proc->pid);
-        serial_puts(" to PID ");
-        serial_put_num(next->pid);
-        serial_puts("\n");
-        
-        context_switch_asm(&current_proc->stack_ptr, &next->stack_ptr);
-    }
-    else
-    {
-        serial_puts("[scheduler] starting first process PID ");
-        serial_put_num(next->pid);
-        serial_puts("\n");
-        
-        context_switch_asm(0, &next->stack_ptr);
-    }
-
-    current_proc = next;
-    current_proc->state = PROC_RUNNING;
-    scheduler.current_quantum = scheduler.time_quantum;
-    scheduler.context_switches++;
-}
-
-// --- Priority Aging ---
-void scheduler_apply_aging(void)
-{
-    uint32_t aged_count = 0;
-
-    for (int i = 0; i < MAX_PROCESSES; i++)
-    {
-        if (proc_table[i].state == PROC_READY && proc_table[i].pid != 0)
-        {
-            proc_table[i].age++;
-
-            if (proc_table[i].age % 10 == 0 && proc_table[i].priority > 1)
-            {
-                proc_table[i].priority--;
-                aged_count++;
-            }
-        }
-    }
-
-    if (aged_count > 0)
-    {
-        serial_puts("[scheduler] aging applied, ");
-        serial_put_num(aged_count);
-        serial_puts(" processes promoted\n");
-    }
-}
-
-// --- Configuration ---
-void scheduler_set_quantum(uint32_t quantum)
-{
-    if (quantum > 0 && quantum <= 100)
-    {
-        scheduler.time_quantum = quantum;
-        scheduler.current_quantum = quantum;
-
-        serial_puts("[scheduler] time quantum set to ");
-        serial_put_num(quantum);
-        serial_puts("ms\n");
-    }
-    else
-    {
-        serial_puts("[scheduler] invalid quantum value\n");
-    }
-}
-
-uint32_t scheduler_get_quantum(void)
-{
-    return scheduler.time_quantum;
-}
-
-uint32_t scheduler_get_switches(void)
-{
-    return scheduler.context_switches;
-}
-
-// --- Statistics ---
-void scheduler_print_stats(void)
-{
-    serial_puts("\n========== SCHEDULER STATISTICS ==========\n");
-    serial_puts("System ticks: ");
-    serial_put_num(scheduler.ticks);
-    serial_puts("\n");
-
-    serial_puts("Context switches: ");
-    serial_put_num(scheduler.context_switches);
-    serial_puts("\n");
-
-    serial_puts("Current quantum: ");
-    serial_put_num(scheduler.time_quantum);
-    serial_puts("ms\n");
-
-    serial_puts("Current process PID: ");
-    if (current_proc)
-        serial_put_num(current_proc->pid);
-    else
-        serial_puts("none");
-    serial_puts("\n");
-
-    serial_puts("\nReady processes:\n");
-    for (int i = 0; i < MAX_PROCESSES; i++)
-    {
-        if (proc_table[i].state == PROC_READY && proc_table[i].pid != 0)
-        {
-            serial_puts("  PID ");
-            serial_put_num(proc_table[i].pid);
-            serial_puts(": priority=");
-            serial_put_num(proc_table[i].priority);
-            serial_puts(", age=");
-            serial_put_num(proc_table[i].age);
-            serial_puts("\n");
-        }
-    }
-    serial_puts("=========================================\n\n");
-}
+// --- Scheduler Implementation ---
+#include "scheduler.h"
+#include "smp.h"
+#include "memory.h"
+#include "serial.h"
+#include "log.h"
+#include "string.h"
+#include "context_switch.h"
+#include "paging.h"
+#include "pit.h"
+#include "cpu.h"
+#include "timer.h"
+#include "trace.h"
+
+/*
+ * Every CPU has its own scheduler_t (in its cpu_t) with its own run
+ * queue and lock, and a READY process is queued on exactly one of them,
+ * p->cpu. scheduler_tick() runs from the local timer interrupt (the PIT
+ * on the boot CPU, the APIC timer elsewhere) and preempts the current
+ * process once its quantum, in milliseconds, has elapsed. The context a
+ * CPU came up in becomes its idle task (current_proc == NULL, stack
+ * pointer kept in idle_sp), which it falls back to whenever nothing is
+ * runnable and which pulls work over from the busiest other CPU.
+ *
+ * Lock order: proc_lock, then run queue locks by ascending CPU id.
+ * Timer callbacks run without the timer lock, so they may enqueue.
+ */
+
+static inline scheduler_t* this_sched(void)
+{
+    return &this_cpu()->sched;
+}
+
+// --- Run Queues ---
+void rq_push(runqueue_t *rq, pcb_t *p, uint32_t level)
+{
+    p->rq_level = level;
+    p->rq_next = NULL;
+    p->rq_prev = rq->tail[level];
+    if (p->rq_prev)
+        p->rq_prev->rq_next = p;
+    else
+        rq->head[level] = p;
+    rq->tail[level] = p;
+
+    rq->bitmap |= 1u << level;
+}
+
+void rq_remove(runqueue_t *rq, pcb_t *p)
+{
+    uint32_t level = p->rq_level;
+
+    if (p->rq_prev)
+        p->rq_prev->rq_next = p->rq_next;
+    else
+        rq->head[level] = p->rq_next;
+    if (p->rq_next)
+        p->rq_next->rq_prev = p->rq_prev;
+    else
+        rq->tail[level] = p->rq_prev;
+
+    p->rq_next = p->rq_prev = NULL;
+
+    if (!rq->head[level])
+        rq->bitmap &= ~(1u << level);
+}
+
+pcb_t* rq_first(runqueue_t *rq)
+{
+    if (!rq->bitmap)
+        return NULL;
+
+    return rq->head[bit_scan_forward(rq->bitmap)];
+}
+
+// --- Static Priority Policy ---
+/*
+ * Run queue level = effective priority. Aging is lazy: a process' wait is
+ * ticks - enqueue_tick, and since each level is FIFO its head has waited
+ * longest. Every tick only the heads are examined; one that has waited
+ * AGING_THRESHOLD moves up a level and starts waiting afresh there. The
+ * work per tick is bounded by the number of levels, not the number of
+ * processes, and the boost is dropped again once the process is
+ * dispatched.
+ */
+static void prio_enqueue(scheduler_t *s, pcb_t *p)
+{
+    rq_push(&s->rq, p, p->priority);
+}
+
+static void prio_dequeue(scheduler_t *s, pcb_t *p)
+{
+    rq_remove(&s->rq, p);
+}
+
+static pcb_t* prio_pick(scheduler_t *s)
+{
+    return rq_first(&s->rq);
+}
+
+static void prio_dispatched(scheduler_t *s, pcb_t *p)
+{
+    (void)s;
+    p->priority = sched_base_priority(p);
+    p->age = 0;
+}
+
+static void prio_age(scheduler_t *s)
+{
+    uint32_t wait = MS_TO_TICKS(AGING_THRESHOLD);
+    uint32_t levels = s->rq.bitmap & ~3u;           /* level 1 is the top */
+
+    while (levels)
+    {
+        uint32_t prio = bit_scan_forward(levels);
+        pcb_t *p = s->rq.head[prio];
+
+        levels &= levels - 1;
+
+        if (s->ticks - p->enqueue_tick < wait)
+            continue;
+
+        rq_remove(&s->rq, p);
+        p->priority--;
+        p->age++;
+        rq_push(&s->rq, p, p->priority);
+        p->enqueue_tick = s->ticks;
+        s->aging_boosts++;
+    }
+}
+
+static void prio_print_stats(scheduler_t *s)
+{
+    struct { uint32_t pid, priority, base, waiting; } rows[SCHED_STATS_ROWS];
+    uint32_t n = 0;
+    uint32_t queued = 0;
+
+    uint32_t flags = spin_lock_irqsave(&s->lock);
+    uint32_t boosts = s->aging_boosts;
+    for (uint32_t prio = 1; prio <= MAX_PRIORITY; prio++)
+    {
+        for (pcb_t *p = s->rq.head[prio]; p; p = p->rq_next, queued++)
+        {
+            if (n == SCHED_STATS_ROWS)
+                continue;
+            rows[n].pid = p->pid;
+            rows[n].priority = p->priority;
+            rows[n].base = p->base_priority;
+            rows[n].waiting = s->ticks - p->enqueue_tick;
+            n++;
+        }
+    }
+    spin_unlock_irqrestore(&s->lock, flags);
+
+    serial_puts("Aging boosts: ");
+    serial_put_num(boosts);
+    serial_puts("\n");
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        serial_puts("  PID ");
+        serial_put_num(rows[i].pid);
+        serial_puts(": priority=");
+        serial_put_num(rows[i].priority);
+        serial_puts(" (base ");
+        serial_put_num(rows[i].base);
+        serial_puts("), waiting=");
+        serial_put_num(rows[i].waiting);
+        serial_puts(" ticks\n");
+    }
+    if (queued > n)
+    {
+        serial_puts("  ... ");
+        serial_put_num(queued - n);
+        serial_puts(" more\n");
+    }
+}
+
+const sched_policy_t sched_priority_policy = {
+    .name        = "priority",
+    .admit       = NULL,
+    .enqueue     = prio_enqueue,
+    .dequeue     = prio_dequeue,
+    .pick        = prio_pick,
+    .dispatched  = prio_dispatched,
+    .stopped     = NULL,
+    .age         = prio_age,
+    .quantum     = NULL,
+    .print_stats = prio_print_stats,
+};
+
+static const sched_policy_t *policies[] = {
+    &sched_priority_policy,
+    &sched_mlfq_policy,
+    &sched_cfs_policy,
+};
+
+#define NUM_POLICIES (sizeof(policies) / sizeof(policies[0]))
+
+// --- CPU Accounting ---
+/*
+ * Per-process times are TSC cycles taken on whichever CPU makes the
+ * transition, so they assume the TSCs of all CPUs tick together.
+ * ready_since survives moves between run queues (stealing, donation
+ * requeues), so a wait counts from when the process became READY.
+ */
+static inline uint32_t hist_bucket(uint32_t us)
+{
+    if (us == 0)
+        return 0;
+
+    uint32_t b = bit_scan_reverse(us) + 1;
+    return b < SCHED_HIST_BUCKETS ? b : SCHED_HIST_BUCKETS - 1;
+}
+
+/* `prev` stops running and `next` starts, either may be the idle task */
+static void account_switch(scheduler_t *s, pcb_t *prev, pcb_t *next)
+{
+    uint64_t now = rdtsc();
+
+    /* run_start is 0 for a process made current by hand (the boot tests) */
+    if (prev && prev->run_start)
+    {
+        uint64_t ran = now - prev->run_start;
+
+        prev->runtime += ran;
+        s->run_hist[hist_bucket(tsc_to_us(ran))]++;
+    }
+
+    if (next)
+    {
+        /* Not READY before a handoff, so no latency to speak of */
+        if (next->ready_since)
+        {
+            uint64_t waited = now - next->ready_since;
+            uint32_t us = tsc_to_us(waited);
+
+            next->wait_time += waited;
+            next->ready_since = 0;
+            s->latency_hist[hist_bucket(us)]++;
+            if (us > s->max_latency)
+                s->max_latency = us;
+        }
+        next->run_start = now;
+        next->nr_switches++;
+    }
+}
+
+// --- Policy Dispatch ---
+/* All of these expect s->lock held */
+static void enqueue_locked(scheduler_t *s, pcb_t *p)
+{
+    p->enqueue_tick = s->ticks;
+    if (!p->ready_since)
+        p->ready_since = rdtsc();
+    s->policy->enqueue(s, p);
+    p->on_rq = 1;
+    s->nr_ready++;
+}
+
+static void dequeue_locked(scheduler_t *s, pcb_t *p)
+{
+    s->policy->dequeue(s, p);
+    p->on_rq = 0;
+    s->nr_ready--;
+}
+
+/* Lock the run queue `p` belongs to; p->cpu only changes under it */
+static scheduler_t* lock_rq(pcb_t *p)
+{
+    for (;;)
+    {
+        scheduler_t *s = &cpus[p->cpu].sched;
+
+        spin_lock(&s->lock);
+        if (s->cpu == p->cpu)
+            return s;
+        spin_unlock(&s->lock);
+    }
+}
+
+/* New processes go to the CPU with the least to do */
+static uint32_t least_loaded_cpu(void)
+{
+    uint32_t best = 0, best_load = ~0u;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        uint32_t load = cpus[i].sched.nr_ready + (cpus[i].current ? 1 : 0);
+
+        if (cpus[i].online && load < best_load)
+        {
+            best = i;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+/* After queueing on `s`: an idle owner is woken, otherwise some idle
+   CPU may want to take the work */
+static void notify_cpu(scheduler_t *s)
+{
+    if (cpus[s->cpu].current)
+        smp_kick_idle();
+    else
+        smp_kick(s->cpu);
+}
+
+/* Give a new process a CPU, and a place on its queue if it is READY */
+void scheduler_admit(pcb_t *p)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = &cpus[least_loaded_cpu()].sched;
+    int ready = p->state == PROC_READY;
+
+    spin_lock(&s->lock);
+    p->cpu = s->cpu;
+    if (s->policy->admit)
+        s->policy->admit(s, p);
+    if (ready)
+        enqueue_locked(s, p);
+    spin_unlock(&s->lock);
+
+    if (ready)
+        notify_cpu(s);
+    irq_restore(flags);
+}
+
+void scheduler_enqueue(pcb_t *p)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = lock_rq(p);
+
+    enqueue_locked(s, p);
+    spin_unlock(&s->lock);
+
+    notify_cpu(s);
+    irq_restore(flags);
+}
+
+/* Take a READY process off its queue; -1 if some CPU has already
+   picked it, in which case it is RUNNING or on its way there */
+int scheduler_dequeue(pcb_t *p)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = lock_rq(p);
+    int queued = p->on_rq;
+
+    if (queued)
+    {
+        dequeue_locked(s, p);
+        p->ready_since = 0;
+    }
+    spin_unlock_irqrestore(&s->lock, flags);
+    return queued ? 0 : -1;
+}
+
+/* Put every queued process of this CPU back on the active policy's
+   queues. Called with proc_lock and s->lock held. */
+static void requeue_cpu(scheduler_t *s)
+{
+    s->rq.bitmap = 0;
+    s->nr_ready = 0;
+    for (uint32_t i = 0; i < RQ_LEVELS; i++)
+        s->rq.head[i] = s->rq.tail[i] = NULL;
+    s->cfs_timeline.node = NULL;
+    s->cfs_leftmost = NULL;
+    s->cfs_weight = 0;
+
+    for (uint32_t i = 0; i < proc_table_size; i++)
+    {
+        pcb_t *p = proc_table[i];
+
+        if (!p || p->state == PROC_UNUSED || p->state == PROC_TERMINATED ||
+            p->cpu != s->cpu)
+            continue;
+        if (s->policy->admit)
+            s->policy->admit(s, p);
+        if (p->on_rq)
+            enqueue_locked(s, p);
+    }
+}
+
+int scheduler_set_policy(const char *name)
+{
+    for (uint32_t i = 0; i < NUM_POLICIES; i++)
+    {
+        if (strcmp(policies[i]->name, name) != 0)
+            continue;
+
+        uint32_t flags = spin_lock_irqsave(&proc_lock);
+        for (uint32_t c = 0; c < ncpus; c++)
+        {
+            scheduler_t *s = &cpus[c].sched;
+
+            spin_lock(&s->lock);
+            s->policy = policies[i];
+            requeue_cpu(s);
+            spin_unlock(&s->lock);
+        }
+        spin_unlock_irqrestore(&proc_lock, flags);
+
+        if (log_on(LOG_INFO, LOG_SCHED))
+        {
+            serial_puts("[scheduler] policy set to ");
+            serial_puts(name);
+            serial_puts("\n");
+        }
+        return 0;
+    }
+
+    serial_puts("[scheduler] unknown policy, available:");
+    for (uint32_t i = 0; i < NUM_POLICIES; i++)
+    {
+        serial_puts(" ");
+        serial_puts(policies[i]->name);
+    }
+    serial_puts("\n");
+    return -1;
+}
+
+const char* scheduler_policy_name(void)
+{
+    return this_sched()->policy->name;
+}
+
+// --- Initialization ---
+static void reset_counters(scheduler_t *s)
+{
+    s->current_quantum = MS_TO_TICKS(DEFAULT_TIME_QUANTUM);
+    s->time_quantum = DEFAULT_TIME_QUANTUM;
+    s->ticks = 0;
+    s->context_switches = 0;
+    s->aging_boosts = 0;
+    s->idle_ticks = 0;
+    s->tickless_entries = 0;
+    s->ticks_suppressed = 0;
+    s->steals = 0;
+    s->handoffs = 0;
+    memset(s->latency_hist, 0, sizeof(s->latency_hist));
+    memset(s->run_hist, 0, sizeof(s->run_hist));
+    s->max_latency = 0;
+}
+
+/* (Re)initialize the calling CPU's scheduler */
+void scheduler_init(void)
+{
+    uint32_t flags = spin_lock_irqsave(&proc_lock);
+    scheduler_t *s = this_sched();
+
+    spin_lock(&s->lock);
+    reset_counters(s);
+    if (!s->policy)
+        s->policy = &sched_priority_policy;
+
+    /* Rebuilding from the table keeps processes that are already READY
+       when the scheduler is re-initialized */
+    requeue_cpu(s);
+
+    spin_unlock(&s->lock);
+    spin_unlock_irqrestore(&proc_lock, flags);
+
+    if (log_on(LOG_INFO, LOG_SCHED))
+    {
+        serial_puts("[scheduler] initialized with quantum=");
+        serial_put_num(DEFAULT_TIME_QUANTUM);
+        serial_puts("ms, policy=");
+        serial_puts(s->policy->name);
+        serial_puts("\n");
+    }
+}
+
+/* Empty scheduler for a CPU that is not running yet, on the boot CPU's
+   policy and quantum */
+void scheduler_init_cpu(scheduler_t *s, uint32_t cpu)
+{
+    scheduler_t *boot = &cpus[0].sched;
+
+    memset(s, 0, sizeof(*s));
+    spin_init(&s->lock);
+    s->cpu = cpu;
+    reset_counters(s);
+    s->policy = boot->policy;
+    s->time_quantum = boot->time_quantum;
+}
+
+// --- Process Selection ---
+pcb_t* scheduler_next(void)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = this_sched();
+
+    spin_lock(&s->lock);
+    pcb_t *next = s->policy->pick(s);
+
+    spin_unlock_irqrestore(&s->lock, flags);
+    return next;
+}
+
+// --- Timer Tick Handler ---
+/* Time keeping for one tick, without any preemption decision. The
+   timer wheel runs on the boot CPU's tick only. */
+static void tick_account(scheduler_t *s)
+{
+    s->ticks++;
+    if (current_proc)
+        current_proc->run_ticks++;
+    else
+        s->idle_ticks++;
+    if (s->cpu == 0)
+        timer_tick();
+    scheduler_apply_aging();
+}
+
+/* Called from the local timer interrupt with interrupts disabled */
+void scheduler_tick(void)
+{
+    scheduler_t *s = this_sched();
+
+    tick_account(s);
+
+    if (current_proc)
+    {
+        if (s->current_quantum > 0)
+            s->current_quantum--;
+
+        if (s->current_quantum == 0)
+            scheduler_context_switch();
+    }
+    else if (s->nr_ready)
+    {
+        /* Idle: hand the CPU to the first arrival */
+        scheduler_context_switch();
+    }
+}
+
+// --- Context Switching ---
+/*
+ * Make `next`, already off every run queue, current on this CPU and
+ * switch to it (NULL: the idle task). Called with the CPU's run queue
+ * lock held and interrupts off since `flags` were saved; returns once
+ * `prev` is switched back in, with the lock dropped and `flags` restored.
+ * With `donate`, `next` runs out the rest of prev's quantum.
+ */
+static void dispatch_locked(cpu_t *cpu, pcb_t *prev, pcb_t *next, uint32_t flags,
+                            int donate)
+{
+    scheduler_t *s = &cpu->sched;
+    const sched_policy_t *policy = s->policy;
+    uint32_t **prev_sp = prev ? &prev->stack_ptr : &cpu->idle_sp;
+
+    if (next)
+    {
+        next->state = PROC_RUNNING;
+        next->on_cpu = 1;
+        if (policy->dispatched)
+            policy->dispatched(s, next);
+    }
+
+    if (!donate || !s->current_quantum)
+        s->current_quantum = MS_TO_TICKS(next && policy->quantum ?
+                                         policy->quantum(s, next) :
+                                         s->time_quantum);
+
+    if (next == prev)
+    {
+        /* Nobody better to run; in the boot context this is a no-op */
+        if (next)
+            next->ready_since = 0;
+        spin_unlock_irqrestore(&s->lock, flags);
+        return;
+    }
+
+    /* Switches are too frequent to log; schedstat counts them and the
+       trace ring keeps the latest */
+    trace_event(TRACE_SWITCH, next ? next->pid : 0, prev ? prev->state : 0);
+    account_switch(s, prev, next);
+    s->context_switches++;
+    cpu->current = next;
+    cpu->prev = prev;
+    spin_unlock(&s->lock);
+
+    if (!next)
+        context_switch_asm(prev_sp, &cpu->idle_sp, paging_kernel_dir());
+    else
+        context_switch_asm(prev_sp, &next->stack_ptr, next->page_dir);
+
+    /* Back here only when something switches to `prev` again, possibly
+       on another CPU: `cpu` and `s` are stale from here on */
+    scheduler_finish_switch();
+    irq_restore(flags);
+}
+
+/*
+ * `prev` may be back on a run queue before its registers are saved, and
+ * another CPU must not resume it until they are. on_cpu covers that
+ * window: it is set at dispatch and cleared by whoever runs next on this
+ * CPU, in scheduler_finish_switch(), and stealing skips processes that
+ * still have it set.
+ */
+void scheduler_context_switch(void)
+{
+    uint32_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    scheduler_t *s = &cpu->sched;
+    pcb_t *prev = cpu->current;
+
+    spin_lock(&s->lock);
+
+    const sched_policy_t *policy = s->policy;
+
+    if (prev && policy->stopped)
+        policy->stopped(s, prev, s->current_quantum == 0);
+
+    /* A caller that is still RUNNING is yielding: back of its queue */
+    if (prev && prev->state == PROC_RUNNING)
+    {
+        prev->state = PROC_READY;
+        enqueue_locked(s, prev);
+    }
+
+    pcb_t *next = policy->pick(s);
+    if (next)
+        dequeue_locked(s, next);
+
+    dispatch_locked(cpu, prev, next, flags, 0);
+}
+
+/*
+ * Direct switch for IPC: `next` runs at once without a pass through the
+ * policy's pick. `next` must be BLOCKED, on no run queue, and already
+ * claimed by the caller, so nobody else can wake it. A caller that is
+ * still RUNNING goes back on this CPU's queue as if it had yielded; one
+ * that has just blocked (an RPC waiting for its reply, a server waiting
+ * for the next request) lends `next` the rest of its quantum instead.
+ * Returns -1 without switching if `next` is still on its way off
+ * another CPU.
+ */
+int scheduler_handoff(pcb_t *next)
+{
+    uint32_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    scheduler_t *s = &cpu->sched;
+    pcb_t *prev = cpu->current;
+
+    if (!prev || next->on_cpu)
+    {
+        irq_restore(flags);
+        return -1;
+    }
+
+    /* next->cpu only changes under its run queue lock */
+    scheduler_t *from = &cpus[next->cpu].sched;
+    scheduler_t *first = from->cpu < s->cpu ? from : s;
+    scheduler_t *second = from->cpu < s->cpu ? s : from;
+
+    spin_lock(&first->lock);
+    if (second != first)
+        spin_lock(&second->lock);
+
+    if (from != s)
+    {
+        next->cpu = s->cpu;
+        if (s->policy->admit)
+            s->policy->admit(s, next);
+        spin_unlock(&from->lock);
+    }
+
+    int yield = prev->state == PROC_RUNNING;
+
+    if (s->policy->stopped)
+        s->policy->stopped(s, prev, 0);
+    if (yield)
+    {
+        prev->state = PROC_READY;
+        enqueue_locked(s, prev);
+    }
+    s->handoffs++;
+    trace_event(TRACE_HANDOFF, next->pid, 0);
+
+    dispatch_locked(cpu, prev, next, flags, !yield);
+    return 0;
+}
+
+/* Lend `p` the priority of an IPC caller blocked on it, or give it back
+   with 0. A queued `p` is requeued where its new priority puts it. */
+void scheduler_donate(pcb_t *p, uint32_t priority)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = lock_rq(p);
+    int queued = p->on_rq;
+
+    if (queued)
+        dequeue_locked(s, p);
+
+    p->donated_priority = priority;
+    if (!priority || priority < p->priority)
+        p->priority = sched_base_priority(p);
+
+    if (queued)
+        enqueue_locked(s, p);
+    spin_unlock_irqrestore(&s->lock, flags);
+}
+
+/* First thing after every switch, on the stack switched to */
+void scheduler_finish_switch(void)
+{
+    cpu_t *cpu = this_cpu();
+
+    if (cpu->prev)
+    {
+        cpu->prev->on_cpu = 0;
+        cpu->prev = NULL;
+    }
+}
+
+// --- Load Balancing ---
+/*
+ * Called by an idle CPU: move the process at the head of the busiest
+ * other run queue over here. Both locks are held, lower CPU id first,
+ * so the process is never seen off both queues. A stolen process is
+ * admitted afresh, since policy state such as vruntime is relative to
+ * the queue it came from.
+ */
+static int steal_work(scheduler_t *s)
+{
+    scheduler_t *src = NULL;
+    uint32_t most = 0;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        scheduler_t *other = &cpus[i].sched;
+
+        if (i != s->cpu && cpus[i].online && other->nr_ready > most)
+        {
+            src = other;
+            most = other->nr_ready;
+        }
+    }
+    if (!src)
+        return 0;
+
+    scheduler_t *first = src->cpu < s->cpu ? src : s;
+    scheduler_t *second = src->cpu < s->cpu ? s : src;
+    int moved = 0;
+
+    spin_lock(&first->lock);
+    spin_lock(&second->lock);
+
+    pcb_t *p = src->policy->pick(src);
+    if (p && !p->on_cpu)
+    {
+        dequeue_locked(src, p);
+        p->cpu = s->cpu;
+        if (s->policy->admit)
+            s->policy->admit(s, p);
+        enqueue_locked(s, p);
+        s->steals++;
+        moved = 1;
+    }
+
+    spin_unlock(&second->lock);
+    spin_unlock(&first->lock);
+    return moved;
+}
+
+// --- Idle Task ---
+/* The timer wheel runs on the boot CPU only, and work queued for an AP
+   comes with a kick, so an idle AP just looks for work to steal now and
+   then */
+#define AP_IDLE_TICKS  MS_TO_TICKS(100)
+
+/*
+ * Runs whenever nothing is READY on this CPU and nothing could be
+ * stolen. On the boot CPU, with no timer due within the next tick, the
+ * periodic interrupt is replaced by a PIT one-shot aimed at the next
+ * timer-wheel deadline; an AP puts its APIC timer in one-shot mode for
+ * AP_IDLE_TICKS. So no idle CPU is woken 1000 times a second. Whatever
+ * wakes it (the one-shot, another IRQ or a kick from another CPU), the
+ * ticks that went by are accounted in one go before the next decision.
+ */
+void scheduler_idle(void)
+{
+    cpu_t *cpu = this_cpu();
+    scheduler_t *s = &cpu->sched;
+
+    if (log_on(LOG_INFO, LOG_SCHED))
+    {
+        serial_puts("[scheduler] idle task running on CPU ");
+        serial_put_num(cpu->id);
+        serial_puts("\n");
+    }
+
+    for (;;)
+    {
+        /* Exited processes are reclaimed here rather than in process_create() */
+        process_reap();
+        irq_save();
+
+        if (s->nr_ready || steal_work(s))
+        {
+            scheduler_context_switch();
+            continue;
+        }
+
+        uint32_t planned = 0;
+
+        if (cpu->id == 0)
+        {
+            uint32_t wait = timer_next_deadline();
+
+            if (wait > 1)
+                planned = pit_oneshot(wait);
+        }
+        else
+        {
+            planned = smp_timer_oneshot(AP_IDLE_TICKS);
+        }
+        if (planned)
+            s->tickless_entries++;
+
+        /* sti takes effect after hlt starts, so no wakeup is lost */
+        __asm__ volatile("sti; hlt; cli");
+
+        if (planned)
+        {
+            uint32_t elapsed = cpu->id == 0 ? pit_oneshot_stop() : smp_timer_oneshot_stop();
+
+            s->ticks_suppressed += elapsed;
+            while (elapsed--)
+                tick_account(s);
+        }
+    }
+}
+
+// --- Priority Aging ---
+/* Per-tick policy housekeeping on this CPU: aging, periodic boosts, ... */
+void scheduler_apply_aging(void)
+{
+    uint32_t flags = irq_save();
+    scheduler_t *s = this_sched();
+
+    spin_lock(&s->lock);
+    if (s->policy->age)
+        s->policy->age(s);
+    spin_unlock_irqrestore(&s->lock, flags);
+}
+
+// --- Configuration ---
+void scheduler_set_quantum(uint32_t quantum)
+{
+    if (quantum > 0 && quantum <= 100)
+    {
+        for (uint32_t i = 0; i < ncpus; i++)
+            cpus[i].sched.time_quantum = quantum;
+        this_sched()->current_quantum = MS_TO_TICKS(quantum);
+
+        if (log_on(LOG_INFO, LOG_SCHED))
+        {
+            serial_puts("[scheduler] time quantum set to ");
+            serial_put_num(quantum);
+            serial_puts("ms\n");
+        }
+    }
+    else
+    {
+        klog(LOG_ERROR, LOG_SCHED, "[scheduler] invalid quantum value\n");
+    }
+}
+
+uint32_t scheduler_get_quantum(void)
+{
+    return this_sched()->time_quantum;
+}
+
+uint32_t scheduler_get_switches(void)
+{
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+        total += cpus[i].sched.context_switches;
+    return total;
+}
+
+uint32_t scheduler_get_handoffs(void)
+{
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+        total += cpus[i].sched.handoffs;
+    return total;
+}
+
+// --- Statistics ---
+static void print_hist(const char *title, const uint32_t *hist)
+{
+    serial_puts(title);
+    serial_puts(":\n");
+
+    for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++)
+    {
+        if (!hist[b])
+            continue;
+
+        serial_puts("  ");
+        if (b == 0)
+            serial_puts("<1us");
+        else
+        {
+            serial_put_num(1u << (b - 1));
+            if (b == SCHED_HIST_BUCKETS - 1)
+                serial_puts("us+");
+            else if (b > 1)
+            {
+                serial_puts("-");
+                serial_put_num((1u << b) - 1);
+                serial_puts("us");
+            }
+            else
+                serial_puts("us");
+        }
+        serial_puts("\t");
+        serial_put_num(hist[b]);
+        serial_puts("\n");
+    }
+}
+
+/* Every CPU's histograms added up; read without the run queue locks,
+   so a sample taken meanwhile may be missing */
+static void print_accounting(void)
+{
+    uint32_t latency[SCHED_HIST_BUCKETS];
+    uint32_t run[SCHED_HIST_BUCKETS];
+    uint32_t max_latency = 0;
+
+    for (uint32_t b = 0; b < SCHED_HIST_BUCKETS; b++)
+    {
+        latency[b] = 0;
+        run[b] = 0;
+        for (uint32_t i = 0; i < ncpus; i++)
+        {
+            latency[b] += cpus[i].sched.latency_hist[b];
+            run[b] += cpus[i].sched.run_hist[b];
+        }
+    }
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        if (cpus[i].sched.max_latency > max_latency)
+            max_latency = cpus[i].sched.max_latency;
+    }
+
+    serial_puts("TSC: ");
+    serial_put_num(tsc_khz / 1000);
+    serial_puts("MHz\n");
+    print_hist("Scheduling latency, READY to RUNNING (all CPUs)", latency);
+    serial_puts("  max ");
+    serial_put_num(max_latency);
+    serial_puts("us\n");
+    print_hist("Run time per dispatch (all CPUs)", run);
+}
+
+/* For the CPU the caller runs on, except the accounting histograms;
+   cpustat has the per-CPU summary */
+void scheduler_print_stats(void)
+{
+    scheduler_t *s = this_sched();
+
+    serial_puts("\n========== SCHEDULER STATISTICS ==========\n");
+    serial_puts("CPU: ");
+    serial_put_num(s->cpu);
+    serial_puts(" of ");
+    serial_put_num(ncpus);
+    serial_puts("\n");
+
+    serial_puts("System ticks: ");
+    serial_put_num(s->ticks);
+    serial_puts("\n");
+
+    serial_puts("Timer frequency: ");
+    serial_put_num(TIMER_HZ);
+    serial_puts("Hz\n");
+
+    serial_puts("Context switches: ");
+    serial_put_num(s->context_switches);
+    serial_puts(" (");
+    serial_put_num(s->handoffs);
+    serial_puts(" IPC handoffs)\n");
+
+    serial_puts("Current quantum: ");
+    serial_put_num(s->time_quantum);
+    serial_puts("ms\n");
+
+    serial_puts("Current process PID: ");
+    if (current_proc)
+        serial_put_num(current_proc->pid);
+    else
+        serial_puts("none");
+    serial_puts("\n");
+
+    serial_puts("Policy: ");
+    serial_puts(s->policy->name);
+    serial_puts("\n");
+
+    serial_puts("Ready processes: ");
+    serial_put_num(s->nr_ready);
+    serial_puts("\n");
+
+    serial_puts("Idle: ");
+    serial_put_num(s->idle_ticks);
+    serial_puts(" ticks");
+    if (s->ticks >= 100)
+    {
+        serial_puts(" (");
+        serial_put_num(s->idle_ticks / (s->ticks / 100));
+        serial_puts("%)");
+    }
+    serial_puts(", tickless ");
+    serial_put_num(s->tickless_entries);
+    serial_puts(" times, ");
+    serial_put_num(s->ticks_suppressed);
+    serial_puts(" ticks suppressed\n");
+
+    print_accounting();
+    timer_print_stats();
+
+    if (s->policy->print_stats)
+        s->policy->print_stats(s);
+    serial_puts("=========================================\n\n");
+}
@@ -1,37 +1,151 @@
-#ifndef SCHEDULER_H
-#define SCHEDULER_H
-
-#include "types.h"
-#include "process.h"
-
-// --- Configuration ---
-#define DEFAULT_TIME_QUANTUM  10
-#define AGING_THRESHOLD       50
-#define MAX_PRIORITY          20
-
-// --- Scheduler State Structure ---
-typedef struct {
-    uint32_t current_quantum;
-    uint32_t time_quantum;
-    uint32_t ticks;
-    uint32_t context_switches;
-} scheduler_t;
-
-extern scheduler_t scheduler;
-
-// --- Core Scheduler API ---
-void scheduler_init(void);
-pcb_t* scheduler_next(void);
-void scheduler_tick(void);
-void scheduler_set_quantum(uint32_t quantum);
-uint32_t scheduler_get_quantum(void);
-uint32_t scheduler_get_switches(void);
-
-// --- Context Switching and Aging ---
-void scheduler_context_switch(void);
-void scheduler_apply_aging(void);
-
-// --- Statistics ---
-void scheduler_print_stats(void);
-
-#endif
\ No newline at end of file
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "types.h"
+#include "process.h"
+#include "spinlock.h"
+
+// --- Configuration ---
+#define DEFAULT_TIME_QUANTUM  10
+#define AGING_THRESHOLD       500   /* ms READY before a one-level boost */
+#define MAX_PRIORITY          20
+#define RQ_LEVELS             (MAX_PRIORITY + 1)
+
+// --- MLFQ Configuration ---
+#define MLFQ_LEVELS           4
+#define MLFQ_BASE_QUANTUM     10    /* ms at level 0, doubled per level */
+#define MLFQ_BOOST_PERIOD     1000  /* ms between boosts back to level 0 */
+
+// --- CFS Configuration ---
+#define CFS_TARGET_LATENCY    20    /* ms to run every READY process once */
+#define CFS_MIN_GRANULARITY   2     /* ms, shortest slice handed out */
+#define CFS_WAKEUP_CREDIT     (CFS_TARGET_LATENCY * 1000 / 2)  /* us */
+#define CFS_NICE0_WEIGHT      1024  /* weight of priority 10 */
+
+// --- Accounting ---
+#define SCHED_HIST_BUCKETS    16    /* <1us, then 1us, 2us, ... 16ms and up */
+#define SCHED_STATS_ROWS      16    /* queued processes print_stats lists */
+
+// --- Run Queue ---
+/*
+ * One FIFO list per level. Bit N of `bitmap` is set when level N is
+ * non-empty, so the lowest non-empty level is the head of bsf(bitmap).
+ * What a level means is up to the policy using it.
+ */
+typedef struct {
+    uint32_t bitmap;
+    pcb_t *head[RQ_LEVELS];
+    pcb_t *tail[RQ_LEVELS];
+} runqueue_t;
+
+void   rq_push(runqueue_t *rq, pcb_t *p, uint32_t level);
+void   rq_remove(runqueue_t *rq, pcb_t *p);
+pcb_t* rq_first(runqueue_t *rq);
+
+// --- Scheduling Policy ---
+/*
+ * A policy owns the order of READY processes. The core scheduler calls
+ * enqueue/dequeue on every READY transition, pick to choose, and the
+ * remaining hooks (any may be NULL) around dispatch and on each tick.
+ * Every hook gets the per-CPU scheduler it acts on, with its lock held,
+ * except print_stats: it copies what it shows under the lock and prints
+ * after dropping it, so a slow serial line never holds up scheduling.
+ */
+typedef struct scheduler scheduler_t;
+
+typedef struct {
+    const char *name;
+    void   (*admit)(scheduler_t *s, pcb_t *p);      /* new to this queue */
+    void   (*enqueue)(scheduler_t *s, pcb_t *p);
+    void   (*dequeue)(scheduler_t *s, pcb_t *p);
+    pcb_t* (*pick)(scheduler_t *s);
+    void   (*dispatched)(scheduler_t *s, pcb_t *p);
+    void   (*stopped)(scheduler_t *s, pcb_t *p, int expired);  /* expired: used its quantum */
+    void   (*age)(scheduler_t *s);                  /* once per tick */
+    uint32_t (*quantum)(scheduler_t *s, pcb_t *p);  /* ms; NULL = time_quantum */
+    void   (*print_stats)(scheduler_t *s);
+} sched_policy_t;
+
+extern const sched_policy_t sched_priority_policy;
+extern const sched_policy_t sched_mlfq_policy;
+extern const sched_policy_t sched_cfs_policy;
+
+// --- Scheduler State Structure ---
+/* One per CPU, inside its cpu_t (see smp.h) */
+struct scheduler {
+    spinlock_t lock;                /* everything below the counters */
+    uint32_t cpu;
+
+    uint32_t current_quantum;
+    uint32_t time_quantum;
+    uint32_t ticks;
+    uint32_t context_switches;
+    uint32_t aging_boosts;
+    uint32_t idle_ticks;
+    uint32_t tickless_entries;
+    uint32_t ticks_suppressed;      /* periodic ticks skipped while idle */
+    uint32_t steals;                /* processes pulled from other CPUs */
+    uint32_t handoffs;              /* direct IPC switches, no pick */
+
+    /* log2 buckets of microseconds, see hist_bucket() */
+    uint32_t latency_hist[SCHED_HIST_BUCKETS];  /* READY to RUNNING */
+    uint32_t run_hist[SCHED_HIST_BUCKETS];      /* run per dispatch */
+    uint32_t max_latency;                       /* us */
+
+    const sched_policy_t *policy;
+    runqueue_t rq;
+    uint32_t nr_ready;
+
+    rb_root_t cfs_timeline;         /* READY processes by vruntime */
+    rb_node_t *cfs_leftmost;
+    uint64_t min_vruntime;
+    uint32_t cfs_weight;            /* sum of queued weights */
+
+    struct {
+        uint32_t level_ticks[MLFQ_LEVELS];  /* ticks spent running per level */
+        uint32_t demotions;
+        uint32_t boosts;
+        uint32_t last_boost;
+    } mlfq;
+};
+
+// --- Priority Donation ---
+/* Base priority, raised to what a blocked IPC caller lent it */
+static inline uint32_t sched_base_priority(const pcb_t *p)
+{
+    if (p->donated_priority && p->donated_priority < p->base_priority)
+        return p->donated_priority;
+    return p->base_priority;
+}
+
+// --- Core Scheduler API ---
+void scheduler_init(void);
+void scheduler_init_cpu(scheduler_t *s, uint32_t cpu);
+pcb_t* scheduler_next(void);
+void scheduler_tick(void);
+void scheduler_set_quantum(uint32_t quantum);
+uint32_t scheduler_get_quantum(void);
+uint32_t scheduler_get_switches(void);
+uint32_t scheduler_get_handoffs(void);
+
+// --- Policy Selection ---
+int scheduler_set_policy(const char *name);
+const char* scheduler_policy_name(void);
+
+// --- Run Queues ---
+void scheduler_admit(pcb_t *p);
+void scheduler_enqueue(pcb_t *p);
+int  scheduler_dequeue(pcb_t *p);
+
+// --- Context Switching and Aging ---
+void scheduler_context_switch(void);
+int  scheduler_handoff(pcb_t *next);
+void scheduler_donate(pcb_t *p, uint32_t priority);
+void scheduler_finish_switch(void);
+void scheduler_idle(void);
+void scheduler_apply_aging(void);
+
+// --- Statistics ---
+void scheduler_print_stats(void);
+
+#endif
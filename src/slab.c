@@ -0,0 +1,324 @@
+// --- Slab Cache Implementation ---
+#include "slab.h"
+#include "pmm.h"
+#include "serial.h"
+#include "log.h"
+#include "spinlock.h"
+
+/*
+ * Each cache holds objects of a single type packed into page-sized slabs.
+ * A slab is one frame from the page frame allocator with its header at
+ * the start of the page, so the slab of any object is found by masking
+ * the object address. Slabs with free objects sit on the cache's
+ * `partial` list and completely used slabs on `full`, which makes both
+ * alloc and free constant time.
+ *
+ * The constructor runs once when a slab is created, not on every alloc.
+ * Objects must be handed back in their constructed state, so the free
+ * list link lives in a hidden word after the object instead of inside it.
+ * The destructor undoes the constructor, and whatever state objects keep
+ * across allocations, when an empty slab goes back to the page frame
+ * allocator. It runs after slab_lock is dropped, so it may free into
+ * other caches.
+ */
+
+typedef struct slab {
+    struct slab *next;
+    struct slab *prev;
+    kmem_cache_t *cache;
+    void *free;                 /* first free object in this slab */
+    uint32_t in_use;
+} slab_t;
+
+struct kmem_cache {
+    const char *name;
+    uint32_t obj_size;          /* size requested by the caller */
+    uint32_t stride;            /* object + free list link, aligned */
+    uint32_t objs_per_slab;
+    void (*ctor)(void *obj);
+    void (*dtor)(void *obj);
+
+    slab_t *partial;
+    slab_t *full;
+
+    uint32_t slabs;
+    uint32_t empty_slabs;
+    uint32_t objs_in_use;
+    uint32_t allocs;
+    uint32_t frees;
+    uint8_t active;
+};
+
+static kmem_cache_t caches[MAX_CACHES];
+static spinlock_t slab_lock = SPINLOCK_INIT;
+
+#define SLAB_OBJ_OFFSET  ((sizeof(slab_t) + 7) & ~7u)
+
+// --- Helper Functions ---
+static inline void** obj_link(kmem_cache_t *cache, void *obj)
+{
+    return (void**)((uint8_t*)obj + cache->stride - sizeof(void*));
+}
+
+static inline slab_t* obj_slab(void *obj)
+{
+    return (slab_t*)((uint32_t)obj & ~(PAGE_SIZE - 1));
+}
+
+static void slab_list_push(slab_t **list, slab_t *slab)
+{
+    slab->prev = 0;
+    slab->next = *list;
+    if (slab->next)
+        slab->next->prev = slab;
+    *list = slab;
+}
+
+static void slab_list_remove(slab_t **list, slab_t *slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+    if (slab->next)
+        slab->next->prev = slab->prev;
+}
+
+/* Get a fresh page, construct every object in it and queue it as partial */
+static slab_t* slab_grow(kmem_cache_t *cache)
+{
+    uint8_t *page = pmm_alloc_page();
+    if (!page)
+        return 0;
+
+    pmm_page(page)->type = PAGE_TYPE_SLAB;
+
+    slab_t *slab = (slab_t*)page;
+    slab->cache = cache;
+    slab->free = 0;
+    slab->in_use = 0;
+
+    /* Link in reverse so objects are handed out in address order */
+    for (int i = cache->objs_per_slab - 1; i >= 0; i--)
+    {
+        void *obj = page + SLAB_OBJ_OFFSET + i * cache->stride;
+
+        if (cache->ctor)
+            cache->ctor(obj);
+
+        *obj_link(cache, obj) = slab->free;
+        slab->free = obj;
+    }
+
+    slab_list_push(&cache->partial, slab);
+    cache->slabs++;
+    cache->empty_slabs++;
+
+    return slab;
+}
+
+/* An empty slab already off the cache's lists: destruct and free it */
+static void slab_destroy(kmem_cache_t *cache, slab_t *slab)
+{
+    if (cache->dtor)
+    {
+        for (uint32_t i = 0; i < cache->objs_per_slab; i++)
+            cache->dtor((uint8_t*)slab + SLAB_OBJ_OFFSET + i * cache->stride);
+    }
+    pmm_free_page(slab);
+}
+
+// --- Cache Creation ---
+kmem_cache_t* kmem_cache_create(const char *name, uint32_t size, void (*ctor)(void *obj),
+                                void (*dtor)(void *obj))
+{
+    uint32_t stride = ((size + 7) & ~7u) + sizeof(void*);
+    stride = (stride + 7) & ~7u;
+
+    if (size == 0 || SLAB_OBJ_OFFSET + stride > PAGE_SIZE)
+    {
+        if (log_on(LOG_ERROR, LOG_SLAB))
+        {
+            serial_puts("[slab] FAIL: bad object size for cache ");
+            serial_puts(name);
+            serial_puts("\n");
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < MAX_CACHES; i++)
+    {
+        kmem_cache_t *cache = &caches[i];
+        if (cache->active)
+            continue;
+
+        cache->name = name;
+        cache->obj_size = size;
+        cache->stride = stride;
+        cache->objs_per_slab = (PAGE_SIZE - SLAB_OBJ_OFFSET) / stride;
+        cache->ctor = ctor;
+        cache->dtor = dtor;
+        cache->partial = 0;
+        cache->full = 0;
+        cache->slabs = 0;
+        cache->empty_slabs = 0;
+        cache->objs_in_use = 0;
+        cache->allocs = 0;
+        cache->frees = 0;
+        cache->active = 1;
+
+        if (log_on(LOG_INFO, LOG_SLAB))
+        {
+            serial_puts("[slab] cache '");
+            serial_puts(name);
+            serial_puts("' created (");
+            serial_put_num(size);
+            serial_puts("B objects, ");
+            serial_put_num(cache->objs_per_slab);
+            serial_puts(" per slab)\n");
+        }
+
+        return cache;
+    }
+
+    klog(LOG_ERROR, LOG_SLAB, "[slab] FAIL: too many caches\n");
+    return 0;
+}
+
+// --- Object Allocation ---
+static void* cache_alloc_locked(kmem_cache_t *cache)
+{
+    if (!cache)
+        return 0;
+
+    slab_t *slab = cache->partial;
+    if (!slab)
+    {
+        slab = slab_grow(cache);
+        if (!slab)
+        {
+            if (log_on(LOG_ERROR, LOG_SLAB))
+            {
+                serial_puts("[slab] FAIL: out of memory for cache ");
+                serial_puts(cache->name);
+                serial_puts("\n");
+            }
+            return 0;
+        }
+    }
+
+    void *obj = slab->free;
+    slab->free = *obj_link(cache, obj);
+
+    if (slab->in_use++ == 0)
+        cache->empty_slabs--;
+
+    if (slab->in_use == cache->objs_per_slab)
+    {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    cache->objs_in_use++;
+    cache->allocs++;
+
+    return obj;
+}
+
+// --- Object Deallocation ---
+/* Returns a slab that became empty and must go to slab_destroy() once
+   slab_lock is dropped, 0 otherwise */
+static slab_t* cache_free_locked(kmem_cache_t *cache, void *obj)
+{
+    if (!cache || !obj)
+        return 0;
+
+    page_t *page = pmm_page(obj);
+    slab_t *slab = obj_slab(obj);
+
+    if (!page || page->type != PAGE_TYPE_SLAB || slab->cache != cache)
+    {
+        if (log_on(LOG_WARN, LOG_SLAB))
+        {
+            serial_puts("[slab] WARNING: free of object not owned by cache ");
+            serial_puts(cache->name);
+            serial_puts("\n");
+        }
+        return 0;
+    }
+
+    if (slab->in_use == cache->objs_per_slab)
+    {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    *obj_link(cache, obj) = slab->free;
+    slab->free = obj;
+
+    cache->objs_in_use--;
+    cache->frees++;
+
+    if (--slab->in_use == 0)
+    {
+        if (cache->empty_slabs >= SLAB_KEEP_EMPTY)
+        {
+            slab_list_remove(&cache->partial, slab);
+            cache->slabs--;
+            return slab;
+        }
+        cache->empty_slabs++;
+    }
+    return 0;
+}
+
+// --- Public Entry Points ---
+void* kmem_cache_alloc(kmem_cache_t *cache)
+{
+    uint32_t flags = spin_lock_irqsave(&slab_lock);
+    void *obj = cache_alloc_locked(cache);
+    spin_unlock_irqrestore(&slab_lock, flags);
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t *cache, void *obj)
+{
+    uint32_t flags = spin_lock_irqsave(&slab_lock);
+    slab_t *empty = cache_free_locked(cache, obj);
+    spin_unlock_irqrestore(&slab_lock, flags);
+
+    if (empty)
+        slab_destroy(cache, empty);
+}
+
+// --- Statistics ---
+void kmem_cache_print_stats(void)
+{
+    serial_puts("\n========== SLAB CACHES ==========\n");
+    serial_puts("Cache       objsize  in-use  slabs  allocs  frees\n");
+
+    for (int i = 0; i < MAX_CACHES; i++)
+    {
+        kmem_cache_t *cache = &caches[i];
+        if (!cache->active)
+            continue;
+
+        serial_puts("  ");
+        serial_puts(cache->name);
+        serial_puts("\t    ");
+        serial_put_num(cache->obj_size);
+        serial_puts("\t     ");
+        serial_put_num(cache->objs_in_use);
+        serial_puts("/");
+        serial_put_num(cache->slabs * cache->objs_per_slab);
+        serial_puts("\t ");
+        serial_put_num(cache->slabs);
+        serial_puts("\t ");
+        serial_put_num(cache->allocs);
+        serial_puts("\t ");
+        serial_put_num(cache->frees);
+        serial_puts("\n");
+    }
+
+    serial_puts("=================================\n\n");
+}
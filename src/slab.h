@@ -0,0 +1,20 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define MAX_CACHES        16
+#define SLAB_KEEP_EMPTY   1     /* empty slabs a cache holds on to */
+
+// --- Object Cache ---
+typedef struct kmem_cache kmem_cache_t;
+
+// --- Slab Cache API ---
+kmem_cache_t* kmem_cache_create(const char *name, uint32_t size, void (*ctor)(void *obj),
+                                void (*dtor)(void *obj));
+void* kmem_cache_alloc(kmem_cache_t *cache);
+void  kmem_cache_free(kmem_cache_t *cache, void *obj);
+void  kmem_cache_print_stats(void);
+
+#endif
@@ -0,0 +1,355 @@
+// --- Symmetric Multiprocessing ---
+#include "smp.h"
+#include "apic.h"
+#include "gdt.h"
+#include "idt.h"
+#include "memory.h"
+#include "paging.h"
+#include "pit.h"
+#include "string.h"
+#include "serial.h"
+#include "cpu.h"
+
+/*
+ * The boot CPU is CPU 0 and keeps the PIT, the 8259 and the timer wheel.
+ * Every application processor (AP) found in the MP table is started with
+ * INIT / STARTUP IPIs into the real-mode trampoline in ap_boot.S, which
+ * brings it to ap_main() on its own stack with the kernel page directory
+ * loaded. From there it ticks off its local APIC timer and becomes an
+ * idle task like kmain's: it runs whatever lands on its run queue and
+ * steals from the busiest CPU when it has nothing to do.
+ */
+
+cpu_t cpus[MAX_CPUS];
+uint32_t ncpus = 1;
+
+static uint32_t lapic_timer_count;      /* APIC timer counts per tick */
+
+/* Per-CPU APIC timer state for tickless idle, see smp_timer_oneshot() */
+static struct {
+    uint32_t ticks;                     /* 0 while ticking */
+    uint32_t count;                     /* counts programmed for them */
+    uint32_t resume;                    /* shortened tick before periodic */
+} idle_timer[MAX_CPUS];
+static volatile uint32_t ap_booting;    /* cpus[] index of the AP coming up */
+
+#define INIT_DELAY_US     10000
+#define STARTUP_DELAY_US  200
+#define ONLINE_WAIT_MS    100
+
+extern uint8_t ap_trampoline[], ap_trampoline_end[];
+extern uint8_t ap_boot_cr3[], ap_boot_cr4[], ap_boot_stack[], ap_boot_entry[];
+
+/* A parameter slot in the copy of the trampoline, not in the original */
+#define TRAMPOLINE_PARAM(sym) \
+    (*(volatile uint32_t*)(AP_TRAMPOLINE + ((sym) - ap_trampoline)))
+
+// --- Interrupt Handlers ---
+/* EOI first, as for the PIC: the tick may switch away */
+static void lapic_timer_irq(regs_t *regs)
+{
+    (void)regs;
+    lapic_eoi();
+
+    uint32_t id = this_cpu()->id;
+
+    /* In one-shot mode the idle loop accounts the elapsed ticks */
+    if (idle_timer[id].ticks)
+        return;
+    if (idle_timer[id].resume)
+    {
+        idle_timer[id].resume = 0;
+        lapic_timer_start(lapic_timer_count);
+    }
+    scheduler_tick();
+}
+
+/* Taking the interrupt is enough to get the idle loop out of hlt */
+static void kick_irq(regs_t *regs)
+{
+    (void)regs;
+    lapic_eoi();
+}
+
+static void flush_irq(regs_t *regs)
+{
+    (void)regs;
+    lapic_eoi();
+    paging_flush_tlb();
+}
+
+static void halt_irq(regs_t *regs)
+{
+    (void)regs;
+    this_cpu()->online = 0;
+    for (;;)
+        __asm__ volatile("cli; hlt");
+}
+
+// --- Boot CPU ---
+/* Must run before anything touches current_proc or the scheduler */
+void smp_early_init(void)
+{
+    cpu_t *cpu = &cpus[0];
+
+    cpu->self = cpu;
+    cpu->id = 0;
+    cpu->online = 1;
+    cpu->sched.cpu = 0;
+
+    gdt_set_percpu(0, cpu, sizeof(cpu_t));
+}
+
+// --- Application Processors ---
+static void ap_main(void)
+{
+    cpu_t *cpu = &cpus[ap_booting];
+
+    gdt_load_ap(cpu->id);
+    idt_load();
+    gdt_set_percpu(cpu->id, cpu, sizeof(cpu_t));
+
+    lapic_init(0);
+    lapic_timer_start(lapic_timer_count);
+
+    cpu->online = 1;
+
+    /* This context is the AP's idle task from now on */
+    scheduler_idle();
+}
+
+/* INIT, then up to two STARTUPs as the MP specification asks */
+static int start_ap(cpu_t *cpu)
+{
+    lapic_send_init(cpu->apic_id);
+    pit_delay_us(INIT_DELAY_US);
+
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++)
+    {
+        lapic_send_startup(cpu->apic_id, AP_TRAMPOLINE >> 12);
+        pit_delay_us(STARTUP_DELAY_US);
+    }
+
+    for (uint32_t ms = 0; ms < ONLINE_WAIT_MS && !cpu->online; ms++)
+        pit_delay_us(1000);
+
+    return cpu->online;
+}
+
+void smp_init(void)
+{
+    uint8_t apic_ids[MAX_CPUS];
+    uint32_t count;
+
+    if (lapic_detect(apic_ids, MAX_CPUS, &count) < 0)
+    {
+        serial_puts("[smp] no MP table or local APIC, running on 1 CPU\n");
+        return;
+    }
+
+    lapic_init(1);
+    cpus[0].apic_id = apic_ids[0];
+
+    isr_register(LAPIC_TIMER_VECTOR, lapic_timer_irq);
+    isr_register(LAPIC_KICK_VECTOR, kick_irq);
+    isr_register(LAPIC_HALT_VECTOR, halt_irq);
+    isr_register(LAPIC_FLUSH_VECTOR, flush_irq);
+
+    lapic_timer_count = lapic_timer_calibrate();
+    if (!lapic_timer_count)
+    {
+        serial_puts("[smp] APIC timer did not count, running on 1 CPU\n");
+        return;
+    }
+
+    memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    TRAMPOLINE_PARAM(ap_boot_cr3) = paging_kernel_dir();
+    TRAMPOLINE_PARAM(ap_boot_cr4) = read_cr4();
+    TRAMPOLINE_PARAM(ap_boot_entry) = (uint32_t)ap_main;
+
+    for (uint32_t i = 1; i < count; i++)
+    {
+        cpu_t *cpu = &cpus[ncpus];
+        uint8_t *stack = alloc_stack(AP_STACK_SIZE);
+
+        if (!stack)
+        {
+            serial_puts("[smp] no memory for AP stack\n");
+            break;
+        }
+
+        cpu->self = cpu;
+        cpu->id = ncpus;
+        cpu->apic_id = apic_ids[i];
+        scheduler_init_cpu(&cpu->sched, ncpus);
+
+        TRAMPOLINE_PARAM(ap_boot_stack) = (uint32_t)(stack + AP_STACK_SIZE);
+        ap_booting = ncpus;
+
+        if (start_ap(cpu))
+        {
+            ncpus++;
+            continue;
+        }
+
+        serial_puts("[smp] APIC ");
+        serial_put_num(cpu->apic_id);
+        serial_puts(" did not come up\n");
+
+        /* It may still be on its way up on this stack and cpu_t: park
+           it in wait-for-SIPI before either is reused */
+        lapic_send_init(cpu->apic_id);
+        pit_delay_us(INIT_DELAY_US);
+        cpu->online = 0;
+        free_stack(stack);
+    }
+
+    serial_puts("[smp] ");
+    serial_put_num(ncpus);
+    serial_puts(" of ");
+    serial_put_num(count);
+    serial_puts(" CPUs online (APIC timer ");
+    serial_put_num(lapic_timer_count);
+    serial_puts(" counts/tick)\n");
+}
+
+// --- Tickless Idle ---
+/*
+ * The APs' counterpart of pit_oneshot(): stop this CPU's periodic APIC
+ * timer and interrupt once after `ticks` ticks instead. Tick boundaries
+ * are kept the same way, the part of the current tick already counted
+ * is taken off and the part left over when it is stopped shortens the
+ * first periodic tick after it. Returns the ticks programmed. Call with
+ * interrupts disabled.
+ */
+uint32_t smp_timer_oneshot(uint32_t ticks)
+{
+    uint32_t id = this_cpu()->id;
+    uint32_t max = lapic_timer_count ? 0xFFFFFFFF / lapic_timer_count : 0;
+
+    /* A single tick is not worth it, and the part of it already gone
+       could leave nothing to program */
+    if (max < 2 || ticks < 2)
+        return 0;
+    if (ticks > max)
+        ticks = max;
+
+    /* Periodic or shortened, the tick ends when the counter gets to 0 */
+    uint32_t now = lapic_timer_current();
+    uint32_t done = now <= lapic_timer_count ? lapic_timer_count - now : 0;
+
+    idle_timer[id].ticks = ticks;
+    idle_timer[id].count = ticks * lapic_timer_count - done;
+    idle_timer[id].resume = 0;
+    lapic_timer_oneshot(idle_timer[id].count);
+    return ticks;
+}
+
+/* Back to periodic mode; returns the whole ticks that elapsed */
+uint32_t smp_timer_oneshot_stop(void)
+{
+    uint32_t id = this_cpu()->id;
+
+    if (!idle_timer[id].ticks)
+        return 0;
+
+    uint32_t counts = idle_timer[id].ticks * lapic_timer_count - lapic_timer_current();
+    uint32_t elapsed = counts / lapic_timer_count;
+    uint32_t partial = counts % lapic_timer_count;
+
+    idle_timer[id].ticks = 0;
+    if (partial)
+    {
+        /* The interrupt ending it switches back to periodic */
+        idle_timer[id].resume = 1;
+        lapic_timer_oneshot(lapic_timer_count - partial);
+    }
+    else
+    {
+        lapic_timer_start(lapic_timer_count);
+    }
+    return elapsed;
+}
+
+// --- Inter-Processor Interrupts ---
+/* Wake `cpu` if it sits in its idle loop; a busy CPU finds new work at
+   its next switch anyway */
+void smp_kick(uint32_t cpu)
+{
+    if (cpu == this_cpu()->id || !cpus[cpu].online || cpus[cpu].current)
+        return;
+    lapic_send_ipi(cpus[cpu].apic_id, LAPIC_KICK_VECTOR);
+}
+
+/* Wake one idle CPU so it can steal the work just queued elsewhere */
+void smp_kick_idle(void)
+{
+    uint32_t self = this_cpu()->id;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        if (i != self && cpus[i].online && !cpus[i].current)
+        {
+            lapic_send_ipi(cpus[i].apic_id, LAPIC_KICK_VECTOR);
+            return;
+        }
+    }
+}
+
+void smp_halt_others(void)
+{
+    if (ncpus > 1)
+        lapic_send_ipi_others(LAPIC_HALT_VECTOR);
+}
+
+/* Not waited for: the sender may hold proc_lock while another CPU spins
+   on it with interrupts off. Each CPU flushes the moment it enables
+   interrupts again, which is before it can run a process on the stack
+   whose guard page prompted the flush (see paging.c). */
+void smp_flush_tlb_others(void)
+{
+    if (ncpus > 1)
+        lapic_send_ipi_others(LAPIC_FLUSH_VECTOR);
+}
+
+// --- Statistics ---
+void smp_print_stats(void)
+{
+    serial_puts("\n========== CPU STATISTICS ==========\n");
+    serial_puts("CPU  APIC  running  ready  switches  steals  idle\n");
+
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        cpu_t *cpu = &cpus[i];
+        scheduler_t *s = &cpu->sched;
+        pcb_t *running = cpu->current;
+
+        serial_puts("  ");
+        serial_put_num(i);
+        serial_puts("   ");
+        serial_put_num(cpu->apic_id);
+        serial_puts("    ");
+        if (!cpu->online)
+            serial_puts("halted");
+        else if (running)
+            serial_put_num(running->pid);
+        else
+            serial_puts("idle");
+        serial_puts("\t   ");
+        serial_put_num(s->nr_ready);
+        serial_puts("\t  ");
+        serial_put_num(s->context_switches);
+        serial_puts("\t    ");
+        serial_put_num(s->steals);
+        serial_puts("\t    ");
+        serial_put_num(s->idle_ticks);
+        if (s->ticks >= 100)
+        {
+            serial_puts(" (");
+            serial_put_num(s->idle_ticks / (s->ticks / 100));
+            serial_puts("%)");
+        }
+        serial_puts("\n");
+    }
+    serial_puts("====================================\n\n");
+}
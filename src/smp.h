@@ -0,0 +1,67 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "types.h"
+#include "scheduler.h"
+#include "apic.h"
+
+// --- Configuration ---
+#define AP_TRAMPOLINE   0x8000          /* real-mode entry, see ap_boot.S */
+#define AP_STACK_SIZE   (16 * 1024)     /* idle task stack of each AP */
+
+// --- Per-CPU State ---
+/*
+ * %gs of every CPU is a segment based at its own cpu_t (see gdt.c), so
+ * the fields at fixed offsets can be read with a single instruction.
+ * That matters for `current`: a process can be preempted and moved to
+ * another CPU between any two instructions, but whichever CPU the one
+ * load runs on has this very process as its current.
+ */
+typedef struct cpu {
+    struct cpu *self;               /* %gs:0 */
+    pcb_t *current;                 /* %gs:4 */
+    uint32_t id;
+    uint32_t apic_id;
+    volatile uint32_t online;
+    uint32_t *idle_sp;              /* saved stack of this CPU's idle task */
+    pcb_t *prev;                    /* switched away from, still on_cpu */
+    scheduler_t sched;
+} cpu_t;
+
+_Static_assert(__builtin_offsetof(cpu_t, current) == 4, "current_proc reads %gs:4");
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t ncpus;
+
+static inline cpu_t* this_cpu(void)
+{
+    cpu_t *cpu;
+    __asm__ volatile("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+static inline pcb_t* this_cpu_current(void)
+{
+    pcb_t *p;
+    __asm__ volatile("movl %%gs:4, %0" : "=r"(p) : : "memory");
+    return p;
+}
+
+#define current_proc  this_cpu_current()
+
+// --- SMP API ---
+void smp_early_init(void);
+void smp_init(void);
+void smp_kick(uint32_t cpu);
+void smp_kick_idle(void);
+void smp_halt_others(void);
+void smp_flush_tlb_others(void);
+
+// --- Tickless Idle ---
+uint32_t smp_timer_oneshot(uint32_t ticks);
+uint32_t smp_timer_oneshot_stop(void);
+
+// --- Statistics ---
+void smp_print_stats(void);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "cpu.h"
+
+// --- Spinlock ---
+/*
+ * Test-and-test-and-set on xchg: waiters spin on a plain read so the
+ * cache line stays shared until the holder releases it. Locks taken in
+ * interrupt context must be taken with spin_lock_irqsave() everywhere,
+ * or an IRQ on the holding CPU would spin on itself.
+ */
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT  { 0 }
+
+static inline void spin_init(spinlock_t *lock) {
+    lock->locked = 0;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+    uint32_t old = 1;
+
+    for (;;) {
+        __asm__ volatile ("xchg %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+        if (!old)
+            return;
+        while (lock->locked)
+            cpu_relax();
+        old = 1;
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    /* x86 stores are not reordered with earlier loads or stores */
+    __asm__ volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+static inline uint32_t spin_lock_irqsave(spinlock_t *lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif
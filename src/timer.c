@@ -0,0 +1,253 @@
+// --- Hierarchical Timer Wheel ---
+#include "timer.h"
+#include "serial.h"
+#include "spinlock.h"
+
+/*
+ * TIMER_LEVELS wheels of TIMER_SLOTS slots each. Level 0 holds timers
+ * due within the next 64 ticks, one slot per tick; each further level
+ * covers 64 times the span of the one below it. A timer is dropped into
+ * the slot for its expiry tick at the coarsest level it needs, so adding
+ * and cancelling are O(1) list operations. Whenever level 0 wraps, the
+ * next slot of level 1 is cascaded down (and so on upwards), so a timer
+ * is moved at most TIMER_LEVELS - 1 times before it fires.
+ *
+ * `next_tick` is the next tick to be processed; all placement is
+ * relative to it. The wheel is driven by the boot CPU's tick but armed
+ * from every CPU, so it sits under timer_lock.
+ */
+
+#define SLOT_MASK  (TIMER_SLOTS - 1)
+
+static ktimer_t *wheel[TIMER_LEVELS][TIMER_SLOTS];
+static uint32_t next_tick;
+static spinlock_t timer_lock = SPINLOCK_INIT;
+
+static struct {
+    uint32_t pending;
+    uint32_t fired;
+    uint32_t cancelled;
+    uint32_t cascaded;
+} timer_stats;
+
+// --- Slot Lists ---
+static void slot_insert(ktimer_t *t)
+{
+    uint32_t delta = t->expires - next_tick;
+    ktimer_t **slot;
+
+    if ((int32_t)delta < 0)
+    {
+        /* Already due: fire on the next tick processed */
+        slot = &wheel[0][next_tick & SLOT_MASK];
+    }
+    else
+    {
+        uint32_t level = 0;
+
+        if (delta > TIMER_MAX_DELAY)
+        {
+            t->expires = next_tick + TIMER_MAX_DELAY;
+            delta = TIMER_MAX_DELAY;
+        }
+        while (delta >> ((level + 1) * TIMER_SLOT_BITS))
+            level++;
+
+        slot = &wheel[level][(t->expires >> (level * TIMER_SLOT_BITS)) & SLOT_MASK];
+    }
+
+    t->slot = slot;
+    t->prev = NULL;
+    t->next = *slot;
+    if (t->next)
+        t->next->prev = t;
+    *slot = t;
+}
+
+static void slot_unlink(ktimer_t *t)
+{
+    if (t->prev)
+        t->prev->next = t->next;
+    else
+        *t->slot = t->next;
+    if (t->next)
+        t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+}
+
+/* Re-file every timer in one slot of `level` relative to next_tick */
+static uint32_t cascade(uint32_t level)
+{
+    uint32_t index = (next_tick >> (level * TIMER_SLOT_BITS)) & SLOT_MASK;
+    ktimer_t *t = wheel[level][index];
+
+    wheel[level][index] = NULL;
+    while (t)
+    {
+        ktimer_t *next = t->next;
+        slot_insert(t);
+        timer_stats.cascaded++;
+        t = next;
+    }
+
+    return index;
+}
+
+// --- Initialization ---
+void timer_init(void)
+{
+    for (uint32_t l = 0; l < TIMER_LEVELS; l++)
+    {
+        for (uint32_t s = 0; s < TIMER_SLOTS; s++)
+            wheel[l][s] = NULL;
+    }
+    next_tick = 0;
+
+    serial_puts("[timer] wheel initialized (");
+    serial_put_num(TIMER_LEVELS);
+    serial_puts(" levels x ");
+    serial_put_num(TIMER_SLOTS);
+    serial_puts(" slots)\n");
+}
+
+// --- Timer API ---
+void timer_setup(ktimer_t *t, void (*fn)(void *arg), void *arg)
+{
+    t->next = t->prev = NULL;
+    t->slot = NULL;
+    t->fn = fn;
+    t->arg = arg;
+    t->pending = 0;
+}
+
+/* (Re)arm `t` to fire `delay` ticks from now */
+void timer_add(ktimer_t *t, uint32_t delay)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+
+    if (t->pending)
+        slot_unlink(t);
+    else
+        timer_stats.pending++;
+
+    t->expires = next_tick + delay;
+    t->pending = 1;
+    slot_insert(t);
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/* Returns 1 if the timer was pending */
+int timer_cancel(ktimer_t *t)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    int was_pending = t->pending;
+
+    if (was_pending)
+    {
+        slot_unlink(t);
+        t->pending = 0;
+        timer_stats.pending--;
+        timer_stats.cancelled++;
+    }
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return was_pending;
+}
+
+uint32_t timer_now(void)
+{
+    return next_tick;
+}
+
+/*
+ * Number of timer_tick() calls before the next timer could fire, or
+ * TIMER_MAX_DELAY when none is pending. Only level 0 is scanned: when it
+ * wraps the next cascade may bring timers down, so the wrap itself is
+ * treated as a deadline.
+ */
+uint32_t timer_next_deadline(void)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    uint32_t index = next_tick & SLOT_MASK;
+    uint32_t wait = 1;
+
+    if (!timer_stats.pending)
+    {
+        wait = TIMER_MAX_DELAY;
+    }
+    else if (index != 0)
+    {
+        for (uint32_t d = 0; ; d++)
+        {
+            uint32_t slot = (index + d) & SLOT_MASK;
+
+            if (wheel[0][slot])
+            {
+                wait = d + 1;
+                break;
+            }
+            if (slot == SLOT_MASK)
+            {
+                wait = d + 2;
+                break;
+            }
+        }
+    }
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+    return wait;
+}
+
+// --- Expiry ---
+/* Process one tick; called from the timer interrupt */
+void timer_tick(void)
+{
+    uint32_t flags = spin_lock_irqsave(&timer_lock);
+    uint32_t index = next_tick & SLOT_MASK;
+    ktimer_t *expired, *t;
+
+    if (index == 0)
+    {
+        for (uint32_t level = 1; level < TIMER_LEVELS && cascade(level) == 0; level++)
+            ;
+    }
+
+    /* Detach the whole slot so callbacks may re-arm themselves. Until a
+       timer is popped it can still be cancelled from another CPU, so the
+       detached list stands in as its slot. */
+    expired = wheel[0][index];
+    wheel[0][index] = NULL;
+    for (t = expired; t; t = t->next)
+        t->slot = &expired;
+    next_tick++;
+
+    /* Callbacks run without the lock; they may take scheduler locks */
+    while ((t = expired) != NULL)
+    {
+        slot_unlink(t);
+        t->pending = 0;
+        timer_stats.pending--;
+        timer_stats.fired++;
+
+        spin_unlock(&timer_lock);
+        t->fn(t->arg);
+        spin_lock(&timer_lock);
+    }
+
+    spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+// --- Statistics ---
+void timer_print_stats(void)
+{
+    serial_puts("Timers: ");
+    serial_put_num(timer_stats.pending);
+    serial_puts(" pending, ");
+    serial_put_num(timer_stats.fired);
+    serial_puts(" fired, ");
+    serial_put_num(timer_stats.cancelled);
+    serial_puts(" cancelled, ");
+    serial_put_num(timer_stats.cascaded);
+    serial_puts(" cascaded\n");
+}
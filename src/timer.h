@@ -0,0 +1,38 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+// --- Timer Wheel Configuration ---
+#define TIMER_LEVELS      4
+#define TIMER_SLOT_BITS   6
+#define TIMER_SLOTS       (1 << TIMER_SLOT_BITS)     /* per level */
+#define TIMER_MAX_DELAY   ((1u << (TIMER_LEVELS * TIMER_SLOT_BITS)) - 1)
+
+// --- Kernel Timer ---
+/*
+ * Timers are embedded in their owner (e.g. the PCB for sleeping) and
+ * never allocated by the wheel. Callbacks run from the timer interrupt
+ * with interrupts disabled and must not block.
+ */
+typedef struct ktimer {
+    struct ktimer *next;
+    struct ktimer *prev;
+    struct ktimer **slot;       /* list head it is linked on */
+    uint32_t expires;           /* absolute tick */
+    void (*fn)(void *arg);
+    void *arg;
+    int pending;
+} ktimer_t;
+
+// --- Timer API ---
+void timer_init(void);
+void timer_setup(ktimer_t *t, void (*fn)(void *arg), void *arg);
+void timer_add(ktimer_t *t, uint32_t delay);
+int  timer_cancel(ktimer_t *t);
+void timer_tick(void);
+uint32_t timer_now(void);
+uint32_t timer_next_deadline(void);
+void timer_print_stats(void);
+
+#endif
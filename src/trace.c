@@ -0,0 +1,183 @@
+// --- Binary Event Trace ---
+#include "trace.h"
+#include "smp.h"
+#include "cpu.h"
+#include "serial.h"
+
+/*
+ * One ring per CPU, written only by that CPU with interrupts off, so a
+ * record needs no lock and no atomic: an interrupt handler cannot cut
+ * into it and the process cannot migrate halfway through. `head` counts
+ * every record ever written; the last TRACE_ENTRIES of them are kept.
+ *
+ * Timestamps are raw TSC values. The rings are merged by them when
+ * dumped, which assumes the TSCs of all CPUs tick together, as they do
+ * on anything with an invariant TSC.
+ */
+
+typedef struct {
+    trace_entry_t entries[TRACE_ENTRIES];
+    uint32_t head;
+} trace_ring_t;
+
+static trace_ring_t rings[MAX_CPUS];
+
+/* Off until %gs points at a cpu_t, see trace_init() */
+volatile uint32_t trace_enabled;
+
+static const struct {
+    const char *name;
+    const char *a;              /* label of each argument, 0: unused */
+    const char *b;
+} events[TRACE_NUM_EVENTS] = {
+    [TRACE_SWITCH]  = { "switch",  "next",  "prev_state" },
+    [TRACE_HANDOFF] = { "handoff", "next",  0 },
+    [TRACE_SEND]    = { "send",    "dest",  "value" },
+    [TRACE_CALL]    = { "call",    "dest",  "value" },
+    [TRACE_RECV]    = { "recv",    "from",  "value" },
+    [TRACE_ALLOC]   = { "kmalloc", "size",  "addr" },
+    [TRACE_FREE]    = { "kfree",   "addr",  0 },
+    [TRACE_CREATE]  = { "create",  "pid",   "priority" },
+    [TRACE_EXIT]    = { "exit",    0,       0 },
+};
+
+// --- Initialization ---
+void trace_init(void)
+{
+    trace_enabled = 1;
+}
+
+// --- Recording ---
+void trace_record(uint32_t event, uint32_t a, uint32_t b)
+{
+    uint32_t flags = irq_save();
+    cpu_t *cpu = this_cpu();
+    trace_ring_t *r = &rings[cpu->id];
+    trace_entry_t *e = &r->entries[r->head & (TRACE_ENTRIES - 1)];
+
+    e->tsc = rdtsc();
+    e->event = event;
+    e->pid = cpu->current ? cpu->current->pid : 0;
+    e->a = a;
+    e->b = b;
+    r->head++;
+    irq_restore(flags);
+}
+
+void trace_clear(void)
+{
+    uint32_t was = trace_enabled;
+
+    trace_enabled = 0;
+    for (uint32_t i = 0; i < MAX_CPUS; i++)
+        rings[i].head = 0;
+    trace_enabled = was;
+}
+
+// --- Decoding ---
+static inline uint32_t ring_first(const trace_ring_t *r)
+{
+    return r->head > TRACE_ENTRIES ? r->head - TRACE_ENTRIES : 0;
+}
+
+static void print_entry(uint32_t cpu, const trace_entry_t *e, uint32_t delta)
+{
+    serial_puts("  +");
+    serial_put_num(delta);
+    serial_puts("\tcpu");
+    serial_put_num(cpu);
+    serial_puts(" pid ");
+    serial_put_num(e->pid);
+    serial_puts("\t");
+
+    if (e->event == 0 || e->event >= TRACE_NUM_EVENTS)
+    {
+        serial_puts("event ");
+        serial_put_num(e->event);
+        serial_puts("\n");
+        return;
+    }
+
+    serial_puts(events[e->event].name);
+    if (events[e->event].a)
+    {
+        serial_puts(" ");
+        serial_puts(events[e->event].a);
+        serial_puts("=");
+        serial_put_num(e->a);
+    }
+    if (events[e->event].b)
+    {
+        serial_puts(" ");
+        serial_puts(events[e->event].b);
+        serial_puts("=");
+        serial_put_num(e->b);
+    }
+    serial_puts("\n");
+}
+
+/* Every CPU's ring merged into one timeline, oldest first, each line
+   with the TSC cycles since the one before it. Tracing is paused
+   meanwhile so the rings hold still. */
+void trace_dump(void)
+{
+    uint32_t was = trace_enabled;
+    uint32_t next[MAX_CPUS];
+    uint64_t last = 0;
+    uint32_t total = 0;
+
+    trace_enabled = 0;
+
+    for (uint32_t i = 0; i < ncpus; i++)
+        next[i] = ring_first(&rings[i]);
+
+    serial_puts("\n========== TRACE ==========\n");
+    serial_puts("  +cycles\tcpu  pid\tevent\n");
+
+    for (;;)
+    {
+        int cpu = -1;
+
+        for (uint32_t i = 0; i < ncpus; i++)
+        {
+            if (next[i] == rings[i].head)
+                continue;
+            if (cpu < 0 ||
+                rings[i].entries[next[i] & (TRACE_ENTRIES - 1)].tsc <
+                rings[cpu].entries[next[cpu] & (TRACE_ENTRIES - 1)].tsc)
+                cpu = i;
+        }
+        if (cpu < 0)
+            break;
+
+        const trace_entry_t *e = &rings[cpu].entries[next[cpu]++ & (TRACE_ENTRIES - 1)];
+        print_entry(cpu, e, total ? (uint32_t)(e->tsc - last) : 0);
+        last = e->tsc;
+        total++;
+
+        /* A full ring's worth of lines would overrun the serial TX ring */
+        serial_flush();
+    }
+
+    serial_put_num(total);
+    serial_puts(" events\n");
+    serial_puts("===========================\n\n");
+
+    trace_enabled = was;
+}
+
+// --- Statistics ---
+void trace_print_status(void)
+{
+    serial_puts("Trace: ");
+    serial_puts(trace_enabled ? "on" : "off");
+    serial_puts(", recorded per CPU:");
+    for (uint32_t i = 0; i < ncpus; i++)
+    {
+        serial_puts(" ");
+        serial_put_num(rings[i].head);
+    }
+    serial_puts(" (last ");
+    serial_put_num(TRACE_ENTRIES);
+    serial_puts(" kept)\n");
+}
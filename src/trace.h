@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+// --- Configuration ---
+#define TRACE_ENTRIES   1024        /* events kept per CPU, a power of two */
+
+// --- Event IDs ---
+typedef enum {
+    TRACE_SWITCH = 1,               /* a: next pid (0 idle), b: prev state */
+    TRACE_HANDOFF,                  /* a: next pid */
+    TRACE_SEND,                     /* a: dest pid,  b: value */
+    TRACE_CALL,                     /* a: dest pid,  b: value */
+    TRACE_RECV,                     /* a: sender pid, b: value */
+    TRACE_ALLOC,                    /* a: size, b: address (0 on failure) */
+    TRACE_FREE,                     /* a: address */
+    TRACE_CREATE,                   /* a: new pid, b: priority */
+    TRACE_EXIT,
+    TRACE_NUM_EVENTS
+} trace_event_t;
+
+// --- Trace Record ---
+/*
+ * Each CPU appends fixed-size binary records to its own ring, with
+ * interrupts off for the few stores it takes, so nothing is shared and
+ * nothing is formatted on the hot path; the oldest records are simply
+ * overwritten. trace_dump() decodes the rings afterwards.
+ */
+typedef struct {
+    uint64_t tsc;
+    uint32_t event;
+    uint32_t pid;                   /* running process, 0 for idle/boot */
+    uint32_t a;
+    uint32_t b;
+} trace_entry_t;
+
+/* Cleared by `trace off` and while the rings are being dumped */
+extern volatile uint32_t trace_enabled;
+
+void trace_record(uint32_t event, uint32_t a, uint32_t b);
+
+static inline void trace_event(uint32_t event, uint32_t a, uint32_t b)
+{
+    if (trace_enabled)
+        trace_record(event, a, b);
+}
+
+// --- Trace API ---
+void trace_init(void);
+void trace_clear(void);
+void trace_dump(void);
+void trace_print_status(void);
+
+#endif
@@ -1,11 +1,13 @@
-/* string.h - String utility functions */
-#ifndef STRING_H
-#define STRING_H
-
-#include "types.h"
-
-size_t strlen(const char* str);
-int strcmp(const char* str1, const char* str2);
-char* strcpy(char* dest, const char* src);
-
+/* string.h - String utility functions */
+#ifndef STRING_H
+#define STRING_H
+
+#include "types.h"
+
+size_t strlen(const char* str);
+int strcmp(const char* str1, const char* str2);
+char* strcpy(char* dest, const char* src);
+void* memset(void* dest, int value, size_t count);
+void* memcpy(void* dest, const void* src, size_t count);
+
 #endif
\ No newline at end of file
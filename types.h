@@ -1,16 +1,18 @@
-/* types.h - Basic type definitions */
-#ifndef TYPES_H
-#define TYPES_H
-
-typedef unsigned int   uint32_t;
-typedef unsigned short uint16_t;
-typedef unsigned char  uint8_t;
-typedef int            int32_t;
-typedef short          int16_t;
-typedef char           int8_t;
-
-typedef uint32_t size_t;
-
-#define NULL  ((void*)0)
-
+/* types.h - Basic type definitions */
+#ifndef TYPES_H
+#define TYPES_H
+
+typedef unsigned long long uint64_t;
+typedef unsigned int   uint32_t;
+typedef unsigned short uint16_t;
+typedef unsigned char  uint8_t;
+typedef long long      int64_t;
+typedef int            int32_t;
+typedef short          int16_t;
+typedef char           int8_t;
+
+typedef uint32_t size_t;
+
+#define NULL  ((void*)0)
+
 #endif
\ No newline at end of file